@@ -0,0 +1,203 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+
+/*
+ * The memory a command needs only while it runs: its arguments, the
+ * URIs it makes, the lists of tracks and indices it hands to
+ * libspotify. Taking it from the arena is moving a pointer, and none
+ * of it is freed on its own; it all goes back at once when the
+ * command is done, and the next command gets the same memory again.
+ * So once the arena has grown to what the commands take, running one
+ * costs no malloc() at all.
+ *
+ * The memory goes back when the next command is read in (see
+ * cmd_exec_unparsed() and cmd_run_queued()), rather than right at
+ * cmd_done(), as a command can be done from a callback deep in a call
+ * that is still using its memory.
+ *
+ * Nothing that can outlive the command may be in the arena. A command
+ * that waits for callbacks keeps what they need in memory of its own,
+ * as it may be given up on while they are still to come.
+ *
+ * Only for the main thread.
+ *
+ * */
+
+/// The size of a chunk, unless one allocation needs more
+#define ARENA_CHUNK 65536
+
+/// The most memory kept from one command to the next
+#define ARENA_KEEP (1 << 20)
+
+/// Every allocation is aligned to this
+#define ARENA_ALIGN 16
+
+struct chunk {
+	struct chunk *next;
+	size_t size;
+	size_t used;
+	unsigned char data[] __attribute__((aligned(ARENA_ALIGN)));
+};
+
+static struct chunk *chunks;
+static struct chunk *current;
+
+/// The last allocation, which arena_realloc() can grow where it is
+static void *last;
+
+static struct arena_counts counts;
+
+
+/**
+ * The first chunk after current with room for size, made if there is
+ * none.
+ * */
+static struct chunk *next_chunk(size_t size){
+	struct chunk **cp = current ? &current->next : &chunks;
+	for(; *cp; cp = &(*cp)->next)
+		if((*cp)->size >= size)
+			break;
+	if(*cp && cp != (current ? &current->next : &chunks)){
+		// Move it to right after current, the skipped ones stay for later
+		struct chunk *c = *cp;
+		*cp = c->next;
+		cp = current ? &current->next : &chunks;
+		c->next = *cp;
+		*cp = c;
+	}
+	if(!*cp){
+		size_t n = size > ARENA_CHUNK ? size : ARENA_CHUNK;
+		struct chunk *c = malloc(sizeof(struct chunk) + n);
+		if(!c)
+			return NULL;
+		c->size = n;
+		c->used = 0;
+		c->next = NULL;
+		*cp = c;
+		counts.grows++;
+	}
+	return *cp;
+}
+
+
+/**
+ * Memory for the running command, gone when it's done.
+ *
+ * @return NULL if out of memory.
+ * */
+void *arena_alloc(size_t size){
+	size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+	if(!current || current->size - current->used < size){
+		struct chunk *c = next_chunk(size);
+		if(!c)
+			return NULL;
+		current = c;
+	}
+	last = current->data + current->used;
+	current->used += size;
+	counts.allocs++;
+	counts.bytes += size;
+	return last;
+}
+
+
+void *arena_calloc(size_t n, size_t size){
+	if(size && n > SIZE_MAX / size)
+		return NULL;
+	void *p = arena_alloc(n * size);
+	if(p)
+		memset(p, 0, n * size);
+	return p;
+}
+
+
+/**
+ * Make an allocation of the arena bigger. The last one grows where it
+ * is if there is room, any other is copied.
+ *
+ * @return NULL if out of memory, then p is still good.
+ * */
+void *arena_realloc(void *p, size_t old_size, size_t size){
+	if(p && p == last){
+		size_t start = (unsigned char *)p - current->data;
+		size_t n = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+		if(current->size - start >= n){
+			counts.bytes += n - (current->used - start);
+			current->used = start + n;
+			return p;
+		}
+	}
+	void *q = arena_alloc(size);
+	if(q && p)
+		memcpy(q, p, old_size < size ? old_size : size);
+	return q;
+}
+
+
+char *arena_strdup(const char *s){
+	size_t n = strlen(s) + 1;
+	char *p = arena_alloc(n);
+	if(p)
+		memcpy(p, s, n);
+	return p;
+}
+
+
+/**
+ * Take back everything, keeping up to ARENA_KEEP of the chunks for
+ * the next command.
+ * */
+void arena_reset(void){
+	struct chunk **cp = &chunks;
+	size_t kept = 0;
+	while(*cp){
+		struct chunk *c = *cp;
+		if(kept + c->size <= ARENA_KEEP || cp == &chunks){
+			kept += c->size;
+			c->used = 0;
+			cp = &c->next;
+		} else {
+			*cp = c->next;
+			free(c);
+		}
+	}
+	current = chunks;
+	last = NULL;
+}
+
+
+/**
+ * Remember how far the arena is taken.
+ * */
+void arena_save(struct arena_mark *m){
+	m->chunk = current;
+	m->used = current ? current->used : 0;
+}
+
+
+/**
+ * Take back what was taken since arena_save(m), and nothing before
+ * it, so a loop in a command can use the same memory for each turn.
+ * */
+void arena_rewind(const struct arena_mark *m){
+	struct chunk *c = m->chunk ? ((struct chunk *)m->chunk)->next : chunks;
+	for(; c; c = c->next)
+		c->used = 0;
+	current = m->chunk;
+	if(current)
+		current->used = m->used;
+	last = NULL;
+}
+
+
+/**
+ * What has been taken from the arena since the last call.
+ * */
+void arena_take_counts(struct arena_counts *c){
+	*c = counts;
+	memset(&counts, 0, sizeof(counts));
+}
@@ -0,0 +1,29 @@
+#ifndef ARENA_H__
+#define ARENA_H__
+
+#include <stddef.h>
+
+/* What has been taken from the arena, see arena_take_counts() */
+struct arena_counts {
+	unsigned long allocs;
+	unsigned long bytes;
+	unsigned long grows;   // times it had to malloc() a chunk
+};
+
+void *arena_alloc(size_t size);
+void *arena_calloc(size_t n, size_t size);
+void *arena_realloc(void *p, size_t old_size, size_t size);
+char *arena_strdup(const char *s);
+void arena_reset(void);
+
+/* How far the arena is taken, to go back to with arena_rewind() */
+struct arena_mark {
+	void *chunk;
+	size_t used;
+};
+
+void arena_save(struct arena_mark *m);
+void arena_rewind(const struct arena_mark *m);
+void arena_take_counts(struct arena_counts *c);
+
+#endif
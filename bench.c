@@ -0,0 +1,674 @@
+#include <fnmatch.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "listify.h"
+#include "cmd.h"
+#include "link.h"
+#include "list.h"
+#include "targets.h"
+#include "handle.h"
+#include "uri.h"
+#include "fakespotify.h"
+#include "arena.h"
+
+
+/*
+ * bench times the building blocks of listify one at a time, each at
+ * a range of sizes, against the libspotify stand-in of fakespotify.c.
+ * loadgen tells how the whole holds up under load, this tells which
+ * part of it to look at, and how it grows.
+ *
+ * A sample is one operation run iters times in a row, and iters is
+ * doubled until a sample takes at least -t ms, so that neither the
+ * clock nor the loop count for much. After one sample to warm up, -n
+ * samples are taken, and what comes out is the time of one operation:
+ * the median of the samples, their quartiles, their median absolute
+ * deviation and the fastest of them. A stray interrupt or page fault
+ * can't move those much, but for numbers to compare across runs, pin
+ * bench to a CPU (taskset).
+ *
+ * The output is a table, or with -j one JSON object a line.
+ *
+ * */
+
+/// Sizes a benchmark is run at, at most, the list ends with 0
+#define MAX_SIZES 8
+
+/// A sample is never more than this many operations
+#define MAX_ITERS (1L << 30)
+
+struct bench {
+	const char *name;
+	const char *what;	// one operation, for -l
+	int sizes[MAX_SIZES];
+	/// Once for each size, before any sample
+	void (*prepare)(int size);
+	/// Before each sample, not timed. May be NULL
+	void (*reset)(int size);
+	void (*run)(int size, long iters);
+};
+
+struct result {
+	long iters;
+	int samples;
+	double median;
+	double q1;
+	double q3;
+	double mad;
+	double min;
+};
+
+/* --- Options --- */
+static int opt_samples = 15;
+static int opt_sample_ms = 10;
+static int opt_json;
+static int opt_list;
+static int opt_verbose;
+
+/// What the operations give back, so that they can't be left out
+static volatile uintptr_t sink;
+
+/// The stand-in takes any application key
+const char g_appkey[] = { 0 };
+const size_t g_appkey_size = sizeof(g_appkey);
+
+
+/* --------------------------------- INPUT ---------------------------------- */
+
+static sp_playlist **playlists;
+static int num_playlists;
+static sp_track **tracks;
+static int num_tracks;
+
+static char playlist_uri[64];
+/// A playlist URI that is in no container
+static char missing_uri[64];
+
+
+static void *must(void *p){
+	if(!p){
+		fprintf(stderr, "bench: out of memory\n");
+		exit(1);
+	}
+	return p;
+}
+
+
+static void format_uri(char *buf, const char *prefix, uint64_t hi, uint64_t lo){
+	struct spid id = { hi, lo };
+	size_t n = strlen(prefix);
+	memcpy(buf, prefix, n);
+	spid_encode(&id, buf + n);
+}
+
+
+/**
+ * Have at least n playlists in playlists[], none of them in the
+ * container yet.
+ */
+static void need_playlists(int n){
+	char uri[64], name[32];
+	if(n <= num_playlists)
+		return;
+	playlists = must(realloc(playlists, n * sizeof(*playlists)));
+	for(; num_playlists < n; num_playlists++){
+		format_uri(uri, "spotify:user:bench:playlist:", 0x62656e6368, num_playlists + 1); // "bench"
+		snprintf(name, sizeof(name), "bench %d", num_playlists + 1);
+		playlists[num_playlists] = fake_playlist(uri, name);
+	}
+}
+
+
+static void need_tracks(int n){
+	char uri[64];
+	if(n <= num_tracks)
+		return;
+	tracks = must(realloc(tracks, n * sizeof(*tracks)));
+	for(; num_tracks < n; num_tracks++){
+		format_uri(uri, "spotify:track:", 0x74726b, num_tracks + 1); // "trk"
+		tracks[num_tracks] = fake_track(uri);
+	}
+}
+
+
+/**
+ * Make the container hold the first n playlists. listify isn't told,
+ * which is as if they were there before it started.
+ */
+static void set_container(int n){
+	need_playlists(n);
+	fake_set_container(g_session, playlists, n);
+}
+
+
+/// n track URIs, each followed by a space but the last
+static char *uri_line(int n){
+	char *line = must(malloc(n * 37 + 1)), *cp = line;
+	int i;
+	*cp = 0;
+	for(i = 0; i < n; i++){
+		if(i)
+			*cp++ = ' ';
+		format_uri(cp, "spotify:track:", 0x74726b, i + 1);
+		cp += strlen(cp);
+	}
+	return line;
+}
+
+
+/* ------------------------------ BENCHMARKS -------------------------------- */
+
+/* --- cmd.c --- */
+
+static char *line, *line_copy;
+static size_t line_size;
+static char **vec;
+
+static void tokenize_prepare(int size){
+	free(line);
+	free(line_copy);
+	line = uri_line(size);
+	line_size = strlen(line) + 1;
+	line_copy = must(malloc(line_size));
+}
+
+
+/*
+ * cmd_tokenize() writes to the line, so each time it gets a fresh copy,
+ * which is timed with it. The arena is reset as cmd_exec_unparsed()
+ * does.
+ */
+static void tokenize_run(int size, long iters){
+	char **argv;
+	long i;
+	for(i = 0; i < iters; i++){
+		arena_reset();
+		memcpy(line_copy, line, line_size);
+		sink += cmd_tokenize(line_copy, &argv);
+	}
+}
+
+
+/*
+ * The words are kept out of the arena, which each run resets.
+ */
+static void dispatch_prepare(int size){
+	char *uris = uri_line(size), **argv;
+	free(line);
+	free(vec);
+	line = must(malloc(strlen(uris) + 11));
+	sprintf(line, "link_type %s", uris);
+	free(uris);
+	vec = must(malloc((size + 1) * sizeof(*vec)));
+	arena_reset();
+	cmd_tokenize(line, &argv);
+	memcpy(vec, argv, (size + 1) * sizeof(*vec));
+}
+
+
+static void dispatch_run(int size, long iters){
+	long i;
+	for(i = 0; i < iters; i++){
+		arena_reset();
+		cmd_dispatch(size + 1, vec);
+	}
+}
+
+
+static char *noop_argv[] = { "vlist_size", NULL };
+
+static void dispatch_noop_run(int size, long iters){
+	long i;
+	for(i = 0; i < iters; i++){
+		arena_reset();
+		cmd_dispatch(1, noop_argv);
+	}
+}
+
+
+/* --- link.c --- */
+
+static void uri_to_link_prepare(int size){
+	format_uri(playlist_uri, "spotify:user:bench:playlist:", 0x62656e6368, 1);
+}
+
+
+static void uri_to_link_run(int size, long iters){
+	long i;
+	for(i = 0; i < iters; i++){
+		sp_link *link = URI_to_link(playlist_uri);
+		sink += (uintptr_t)link;
+		handle_link_release(&link);
+	}
+}
+
+
+static void link_type_label_run(int size, long iters){
+	long i;
+	int lt;
+	for(i = 0; i < iters; i++)
+		for(lt = SP_LINKTYPE_INVALID; lt <= SP_LINKTYPE_PLAYLIST; lt++)
+			sink += (uintptr_t)get_link_type_label(lt);
+}
+
+
+/*
+ * Hiding a playlist that isn't in the container looks at all of it,
+ * and changes nothing.
+ */
+static void scan_prepare(int size){
+	set_container(size);
+	format_uri(missing_uri, "spotify:user:bench:playlist:", 0x6d697373, 1); // "miss"
+}
+
+
+static void hide_scan_run(int size, long iters){
+	long i;
+	for(i = 0; i < iters; i++)
+		sink += hide_playlist(missing_uri);
+}
+
+
+static void targets_scan_run(int size, long iters){
+	char *argv[] = { missing_uri };
+	struct targets t;
+	long i;
+	for(i = 0; i < iters; i++){
+		if(!targets_resolve(1, argv, &t))
+			sink += t.num;
+		targets_free(&t);
+		arena_reset();
+	}
+}
+
+
+/* --- list.c --- */
+
+static char *name, *name_copy;
+
+static void new_playlist_prepare(int size){
+	int i;
+	set_container(0);
+	free(name);
+	free(name_copy);
+	name = must(malloc(size + 1));
+	name_copy = must(malloc(size + 1));
+	for(i = 0; i < size; i++)
+		name[i] = i % 8 == 7 ? '_' : 'a' + i % 8;
+	name[size] = 0;
+}
+
+
+/// Hide what the last sample made, telling listify, so it doesn't pile up
+static void new_playlist_reset(int size){
+	int n;
+	while((n = sp_playlistcontainer_num_playlists(g_pc)) > 0)
+		sp_playlistcontainer_remove_playlist(g_pc, n - 1);
+}
+
+
+static void new_playlist_run(int size, long iters){
+	long i;
+	for(i = 0; i < iters; i++){
+		memcpy(name_copy, name, size + 1);
+		char *URI = new_playlist(name_copy);
+		sink += (uintptr_t)URI;
+		arena_reset();
+	}
+}
+
+
+/* --- vlist.c --- */
+
+static char **vlist_argv;
+
+static void vlist_add_prepare(int size){
+	char *uris = uri_line(size), **argv;
+	set_container(0);
+	free(line);
+	free(vlist_argv);
+	line = must(malloc(strlen(uris) + 16));
+	sprintf(line, "vlist_add bench %s", uris);
+	free(uris);
+	vlist_argv = must(malloc((size + 2) * sizeof(*vlist_argv)));
+	arena_reset();
+	cmd_tokenize(line, &argv);
+	memcpy(vlist_argv, argv, (size + 2) * sizeof(*vlist_argv));
+}
+
+
+/// Hide the shards, and let the stand-in sync what was added to them
+static void vlist_add_reset(int size){
+	int next_timeout;
+	new_playlist_reset(size);
+	sp_session_process_events(g_session, &next_timeout);
+}
+
+
+/*
+ * The handler is called directly, through cmd_dispatch() it would be
+ * queued once the changes pile up, see pending.c.
+ */
+static void vlist_add_run(int size, long iters){
+	long i;
+	for(i = 0; i < iters; i++){
+		arena_reset();
+		cmd_vlist_add(size + 2, vlist_argv);
+	}
+}
+
+
+/*
+ * The callbacks are given by the stand-in, as libspotify would, so the
+ * _bare benchmarks do the same on a playlist listify doesn't follow,
+ * which is what the stand-in itself costs.
+ */
+
+static sp_playlist *followed;
+static int *indices;
+
+static void followed_prepare(int size){
+	int i;
+	need_playlists(2);
+	need_tracks(size);
+	if(!followed){
+		followed = playlists[0];
+		playlist_pin(followed);
+	}
+	fake_set_tracks(playlists[0], NULL, 0);
+	fake_set_tracks(playlists[1], NULL, 0);
+	free(indices);
+	indices = must(malloc(size * sizeof(*indices)));
+	for(i = 0; i < size; i++)
+		indices[i] = i;
+}
+
+
+static void tracks_run(sp_playlist *pl, int size, long iters){
+	long i;
+	for(i = 0; i < iters; i++){
+		fake_tracks_added(pl, tracks, size, 0);
+		fake_tracks_removed(pl, indices, size);
+	}
+}
+
+
+static void cb_tracks_run(int size, long iters){
+	tracks_run(followed, size, iters);
+}
+
+
+static void cb_tracks_bare_run(int size, long iters){
+	tracks_run(playlists[1], size, iters);
+}
+
+
+static void cb_renamed_run(int size, long iters){
+	long i;
+	for(i = 0; i < iters; i++)
+		fake_playlist_renamed(followed, i & 1 ? "bench a" : "bench b");
+}
+
+
+static void cb_playlist_prepare(int size){
+	need_playlists(size + 1);
+	set_container(size);
+}
+
+
+static void cb_playlist_run(int size, long iters){
+	sp_playlist *pl = playlists[size];
+	long i;
+	for(i = 0; i < iters; i++){
+		fake_playlist_added(g_session, pl, size);
+		fake_playlist_removed(g_session, pl, size);
+	}
+}
+
+
+static const struct bench benches[] = {
+	{ "tokenize", "split a line of <size> track URIs",
+	  { 4, 32, 1024, 50000 }, tokenize_prepare, NULL, tokenize_run },
+	{ "dispatch", "run link_type on <size> track URIs",
+	  { 1, 32, 1024 }, dispatch_prepare, NULL, dispatch_run },
+	{ "dispatch_noop", "run vlist_size, which does next to nothing",
+	  { 1 }, NULL, NULL, dispatch_noop_run },
+	{ "uri_to_link", "URI_to_link() of a playlist URI, and the release",
+	  { 1 }, uri_to_link_prepare, NULL, uri_to_link_run },
+	{ "link_type_label", "get_link_type_label() of all six link types",
+	  { 1 }, NULL, NULL, link_type_label_run },
+	{ "hide_scan", "hide_playlist() of a URI not in <size> playlists",
+	  { 10, 100, 1000, 10000, 100000 }, scan_prepare, NULL, hide_scan_run },
+	{ "targets_scan", "targets_resolve() of a URI not in <size> playlists",
+	  { 10, 100, 1000, 10000, 100000 }, scan_prepare, NULL, targets_scan_run },
+	{ "new_playlist", "new_playlist() with a <size> character name",
+	  { 8, 64, 190 }, new_playlist_prepare, new_playlist_reset, new_playlist_run },
+	{ "vlist_add", "vlist_add of <size> track URIs",
+	  { 1, 100, 1000 }, vlist_add_prepare, vlist_add_reset, vlist_add_run },
+	{ "cb_tracks", "tracks_added and tracks_removed of <size> tracks",
+	  { 1, 10, 100, 1000 }, followed_prepare, NULL, cb_tracks_run },
+	{ "cb_tracks_bare", "the same on a playlist without our callbacks",
+	  { 1, 10, 100, 1000 }, followed_prepare, NULL, cb_tracks_bare_run },
+	{ "cb_renamed", "playlist_renamed",
+	  { 1 }, followed_prepare, NULL, cb_renamed_run },
+	{ "cb_playlist", "playlist_added and playlist_removed, <size> in the container",
+	  { 10, 1000, 100000 }, cb_playlist_prepare, NULL, cb_playlist_run },
+};
+#define NUM_BENCHES (sizeof(benches) / sizeof(benches[0]))
+
+
+/* ------------------------------- MEASURING -------------------------------- */
+
+static uint64_t now_ns(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+/**
+ * One sample.
+ *
+ * @return how long it took, in ns.
+ */
+static uint64_t sample(const struct bench *b, int size, long iters){
+	if(b->reset)
+		b->reset(size);
+	uint64_t t0 = now_ns();
+	b->run(size, iters);
+	return now_ns() - t0;
+}
+
+
+static int compare_double(const void *a, const void *b){
+	double x = *(const double *)a, y = *(const double *)b;
+	return x < y ? -1 : x > y;
+}
+
+
+/**
+ * The q quantile of the sorted v, interpolated between ranks.
+ */
+static double quantile(const double *v, int n, double q){
+	double at = q * (n - 1);
+	int i = (int)at;
+	if(i >= n - 1)
+		return v[n - 1];
+	return v[i] + (at - i) * (v[i + 1] - v[i]);
+}
+
+
+static void measure(const struct bench *b, int size, struct result *r){
+	double *v = must(malloc(opt_samples * sizeof(*v)));
+	double *dev = must(malloc(opt_samples * sizeof(*dev)));
+	uint64_t min_ns = opt_sample_ms * 1000000ULL;
+	long iters = 1;
+	int i;
+
+	if(b->prepare)
+		b->prepare(size);
+	while(sample(b, size, iters) < min_ns && iters < MAX_ITERS)
+		iters *= 2;
+	sample(b, size, iters);
+
+	for(i = 0; i < opt_samples; i++)
+		v[i] = (double)sample(b, size, iters) / iters;
+	qsort(v, opt_samples, sizeof(*v), compare_double);
+	r->iters = iters;
+	r->samples = opt_samples;
+	r->median = quantile(v, opt_samples, 0.5);
+	r->q1 = quantile(v, opt_samples, 0.25);
+	r->q3 = quantile(v, opt_samples, 0.75);
+	r->min = v[0];
+	for(i = 0; i < opt_samples; i++)
+		dev[i] = v[i] > r->median ? v[i] - r->median : r->median - v[i];
+	qsort(dev, opt_samples, sizeof(*dev), compare_double);
+	r->mad = quantile(dev, opt_samples, 0.5);
+	free(v);
+	free(dev);
+}
+
+
+static void report_header(FILE *f){
+	if(opt_json)
+		return;
+	fprintf(f, "%-16s %8s %10s %12s %12s %12s %7s %12s\n", "ns/op", "size",
+	        "iters", "median", "q1", "q3", "mad%", "min");
+}
+
+
+static void report(FILE *f, const struct bench *b, int size, const struct result *r){
+	if(opt_json){
+		fprintf(f, "{\"bench\":\"%s\",\"size\":%d,\"iters\":%ld,\"samples\":%d,"
+		        "\"median_ns\":%.1f,\"q1_ns\":%.1f,\"q3_ns\":%.1f,"
+		        "\"mad_ns\":%.1f,\"min_ns\":%.1f}\n",
+		        b->name, size, r->iters, r->samples, r->median, r->q1, r->q3,
+		        r->mad, r->min);
+	} else {
+		fprintf(f, "%-16s %8d %10ld %12.1f %12.1f %12.1f %7.2f %12.1f\n",
+		        b->name, size, r->iters, r->median, r->q1, r->q3,
+		        r->median > 0 ? 100 * r->mad / r->median : 0, r->min);
+	}
+	fflush(f);
+}
+
+
+/* ------------------------------ LISTIFY GLUE ------------------------------ */
+
+/*
+ * There is no prompt to show when a command is done, and what stats.c
+ * would tell is no use here.
+ */
+void cmd_done(void)
+{
+}
+
+
+/*
+ * The stand-in changes things only when it's told to, nothing needs
+ * waking up.
+ */
+void notify_main_thread(sp_session *session)
+{
+}
+
+
+void notify_work_done(void)
+{
+}
+
+
+static void usage(void)
+{
+	fprintf(stderr,
+	        "Usage: bench [options] [pattern ...]\n"
+	        "  -n <count>   samples of each benchmark (%d)\n"
+	        "  -t <ms>      the least time of a sample (%d)\n"
+	        "  -j           one JSON object a line, instead of a table\n"
+	        "  -l           list the benchmarks\n"
+	        "  -v           show what listify prints\n"
+	        "Only the benchmarks with names matching a pattern are run, all if none.\n",
+	        opt_samples, opt_sample_ms);
+	exit(1);
+}
+
+
+static int wanted(const char *bench_name, char **patterns, int n){
+	int i;
+	if(!n)
+		return 1;
+	for(i = 0; i < n; i++)
+		if(!fnmatch(patterns[i], bench_name, 0))
+			return 1;
+	return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+	struct result r;
+	unsigned int i;
+	int c, j, out, timeout;
+
+	while((c = getopt(argc, argv, "n:t:jlv")) != -1){
+		switch(c){
+		case 'n': opt_samples = atoi(optarg); break;
+		case 't': opt_sample_ms = atoi(optarg); break;
+		case 'j': opt_json = 1; break;
+		case 'l': opt_list = 1; break;
+		case 'v': opt_verbose = 1; break;
+		default: usage();
+		}
+	}
+	if(opt_samples < 1 || opt_sample_ms < 0)
+		usage();
+
+	if(opt_list){
+		for(i = 0; i < NUM_BENCHES; i++){
+			printf("%-16s %s, size", benches[i].name, benches[i].what);
+			for(j = 0; j < MAX_SIZES && benches[i].sizes[j]; j++)
+				printf(" %d", benches[i].sizes[j]);
+			printf("\n");
+		}
+		return 0;
+	}
+
+	// What listify prints would swamp the numbers
+	fflush(stdout);
+	out = dup(1);
+	if(!opt_verbose && !freopen("/dev/null", "w", stdout)){
+		perror("/dev/null");
+		exit(1);
+	}
+	FILE *f = fdopen(out, "w");
+	if(!f){
+		perror("bench");
+		exit(1);
+	}
+
+	if((c = spshell_init("bench", "")) != 0)
+		exit(c);
+	// The stand-in logs in and loads the container right away
+	sp_session_process_events(g_session, &timeout);
+	if(!g_pc){
+		fprintf(stderr, "bench: no playlist container\n");
+		exit(1);
+	}
+
+	report_header(f);
+	for(i = 0; i < NUM_BENCHES; i++){
+		if(!wanted(benches[i].name, argv + optind, argc - optind))
+			continue;
+		for(j = 0; j < MAX_SIZES && benches[i].sizes[j]; j++){
+			measure(&benches[i], benches[i].sizes[j], &r);
+			report(f, &benches[i], benches[i].sizes[j], &r);
+		}
+	}
+	fclose(f);
+	return 0;
+}
@@ -0,0 +1,269 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "listify.h"
+#include "cmd.h"
+#include "link.h"
+#include "handle.h"
+#include "browse.h"
+
+
+/*
+ * Listing the tracks of a playlist, a page at a time. Only the tracks
+ * of the page being printed and of the one after it are referenced,
+ * so libspotify loads the metadata of those and nothing else, and a
+ * long playlist starts printing as soon as its first page is in.
+ * Memory stays at two pages however long the playlist is.
+ * 
+ * All of the output goes through one buffer, written out once a page.
+ * 
+ * */
+
+/* The size of the output buffer */
+#define OUT_SIZE 8192
+
+static char out_buf[OUT_SIZE];
+static int out_len;
+
+
+/**
+ * Write what has been buffered to stdout.
+ * */
+void out_flush(void){
+	if(out_len)
+		fwrite(out_buf, 1, out_len, stdout);
+	out_len = 0;
+	fflush(stdout);
+}
+
+
+/**
+ * printf() to the output buffer. Lines longer than the buffer are cut.
+ * */
+void out_printf(const char *fmt, ...){
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(out_buf + out_len, OUT_SIZE - out_len, fmt, ap);
+	va_end(ap);
+	if(n >= OUT_SIZE - out_len && out_len){
+		// Didn't fit, make room and try once more
+		out_flush();
+		va_start(ap, fmt);
+		n = vsnprintf(out_buf, OUT_SIZE, fmt, ap);
+		va_end(ap);
+	}
+	if(n < 0)
+		return;
+	out_len += n < OUT_SIZE - out_len ? n : OUT_SIZE - 1 - out_len;
+}
+
+
+/**
+ * Print a track on one line: artists, name, duration and URI.
+ * */
+void print_track(sp_track *track){
+	char URI[256];
+	int i, secs;
+
+	switch(sp_track_error(track)){
+	case SP_ERROR_OK:
+		break;
+	case SP_ERROR_IS_LOADING:
+		out_printf("(loading)\n");
+		return;
+	default:
+		out_printf("(unavailable)\n");
+		return;
+	}
+
+	for(i = 0; i < sp_track_num_artists(track); i++){
+		sp_artist *artist = sp_track_artist(track, i);
+		out_printf("%s%s", i ? ", " : "", artist ? sp_artist_name(artist) : "?");
+	}
+	secs = sp_track_duration(track) / 1000;
+	out_printf(" - %s (%d:%02d)", sp_track_name(track), secs / 60, secs % 60);
+	if(track_to_URI(track, URI, sizeof(URI)))
+		out_printf("  %s", URI);
+	out_printf("\n");
+}
+
+
+/// The tracks referenced: the page being printed and the one after it
+#define HELD (2 * BROWSE_PAGE)
+
+static struct {
+	sp_playlist *pl;      // NULL if no browse is running
+	int pos;              // the next track to print
+	int end;              // one past the last track to print
+	int held_to;          // one past the last track referenced
+	unsigned int token;   // the command to finish when done, 0 if none
+	void (*saved_fn)(void);
+	sp_track *held[HELD]; // track i is in held[i % HELD]
+} b;
+
+static int browse_progress(void);
+
+
+/**
+ * Drop the tracks and the playlist, and give back metadata_updated_fn.
+ * */
+static void browse_stop(void){
+	for(; b.held_to > b.pos; b.held_to--)
+		handle_track_release(&b.held[(b.held_to - 1) % HELD]);
+	handle_playlist_release(&b.pl);
+	metadata_updated_fn = b.saved_fn;
+	b.token = 0;
+}
+
+
+/**
+ * The command was given up on, print no more of it.
+ * */
+static void browse_cancel(void *data){
+	if(b.pl)
+		browse_stop();
+}
+
+
+/**
+ * Reference the tracks up to the end of the page after the current.
+ * */
+static void browse_hold(void){
+	int to = b.pos + HELD;
+	if(to > b.end)
+		to = b.end;
+	for(; b.held_to < to; b.held_to++){
+		sp_track *track = sp_playlist_track(b.pl, b.held_to);
+		b.held[b.held_to % HELD] = track ? handle_track_ref(track) : NULL;
+	}
+}
+
+
+/**
+ * @return non-zero if the metadata of every track on the current page
+ *         is in, or failed to be.
+ * */
+static int browse_page_ready(void){
+	int i, to = b.pos + BROWSE_PAGE;
+	if(to > b.end)
+		to = b.end;
+	for(i = b.pos; i < to; i++){
+		sp_track *track = b.held[i % HELD];
+		if(track && sp_track_error(track) == SP_ERROR_IS_LOADING)
+			return 0;
+	}
+	return 1;
+}
+
+
+/**
+ * Called by libspotify when metadata has been loaded.
+ * */
+static void browse_metadata_updated(void){
+	if(b.pl)
+		browse_progress();
+}
+
+
+/**
+ * Print the pages that are ready, and finish when there's no more.
+ * 
+ * @return -1 if the browse is done, 0 if it waits for metadata.
+ * */
+static int browse_progress(void){
+	while(b.pos < b.end){
+		// The playlist may have shrunk under us
+		int num = sp_playlist_num_tracks(b.pl);
+		if(b.end > num)
+			b.end = num;
+		if(b.held_to > b.end){
+			for(; b.held_to > b.end && b.held_to > b.pos; b.held_to--)
+				handle_track_release(&b.held[(b.held_to - 1) % HELD]);
+		}
+
+		browse_hold();
+		if(!browse_page_ready())
+			return 0;
+
+		int to = b.pos + BROWSE_PAGE;
+		if(to > b.end)
+			to = b.end;
+		for(; b.pos < to; b.pos++){
+			sp_track **track = &b.held[b.pos % HELD];
+			out_printf("%6d. ", b.pos);
+			if(*track)
+				print_track(*track);
+			else
+				out_printf("(none)\n");
+			handle_track_release(track);
+		}
+		out_flush();
+	}
+
+	unsigned int token = b.token;
+	browse_stop();
+	if(token)
+		cmd_complete(token);
+	return -1;
+}
+
+
+/**
+ * Print the tracks of a playlist, from offset and at most limit of them.
+ * 
+ * @param limit -1 for all of them.
+ * 
+ * @return -1 if done or failed, 0 if it will call cmd_complete() when
+ *         done. Just as for a command.
+ * */
+int browse_playlist(sp_playlist *pl, int offset, int limit){
+	if(b.pl){
+		fprintf(stderr, "Already listing a playlist.\n");
+		return -1;
+	}
+	if(!sp_playlist_is_loaded(pl)){
+		fprintf(stderr, "The playlist isn't loaded yet, try again.\n");
+		return -1;
+	}
+
+	int num = sp_playlist_num_tracks(pl);
+	if(offset < 0 || offset > num)
+		offset = num;
+	out_printf("%s, %d tracks\n", sp_playlist_name(pl), num);
+
+	b.pl = handle_playlist_ref(pl);
+	b.pos = b.held_to = offset;
+	b.end = (limit < 0 || limit > num - offset) ? num : offset + limit;
+	b.token = 0;
+	b.saved_fn = metadata_updated_fn;
+	metadata_updated_fn = browse_metadata_updated;
+
+	if(browse_progress() < 0)
+		return -1;
+	out_flush();
+	b.token = cmd_token();
+	cmd_on_cancel(&browse_cancel, NULL);
+	return 0;
+}
+
+
+/**
+ * List the tracks of a playlist.
+ * 
+ * @param 1
+ * The full URI of the playlist.
+ * @param 2
+ * The number of the first track to list, 0 by default.
+ * @param 3
+ * The number of tracks to list, all by default.
+ * 
+ * @return -1 if done or failed, 0 if it waits for metadata.
+ * */
+int cmd_list_tracks(int argc, char **argv){
+	int offset = cmd_arg_int(2, 0);
+	int limit = cmd_arg_int(3, -1);
+	return browse_playlist(cmd_arg_playlist(1), offset, limit);
+}
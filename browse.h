@@ -0,0 +1,12 @@
+#ifndef BROWSE_H__
+#define BROWSE_H__
+
+#include <libspotify/api.h>
+
+/* The number of tracks printed at a time by browse_playlist() */
+#define BROWSE_PAGE 50
+
+void out_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+void out_flush(void);
+
+#endif
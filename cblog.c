@@ -0,0 +1,376 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "listify.h"
+#include "link.h"
+#include "ptrmap.h"
+#include "stats.h"
+#include "handle.h"
+#include "cblog.h"
+
+
+/*
+ * A log of every session, container and playlist callback we get, for
+ * "listify --record <file>". replay.c feeds it back to the callbacks,
+ * so that changes to them and to the main loop can be timed on the
+ * very same input, see "loadgen -R".
+ *
+ * The log is CBLOG_MAGIC and then the records, each
+ *
+ *   <type> <usec since the last record> <what the type has>
+ *
+ * The type is a byte, the numbers are unsigned LEB128 varints and the
+ * strings are a varint length and the bytes. Playlists and tracks are
+ * numbered from 1 in the order they first show up, and the number is
+ * followed by the URI the first time, and by the name as well for a
+ * playlist. 0 is no playlist or track. The types have
+ *
+ *   LOGGED_IN               <error> <container>
+ *   CONNECTION_ERROR        <error>
+ *   LOG_MESSAGE             <string>
+ *   PLAYLIST_ADDED          <playlist> <position>
+ *   PLAYLIST_REMOVED        <playlist> <position>
+ *   CONTAINER_LOADED        <container>
+ *   TRACKS_ADDED            <playlist> <position> <n> <track> ...
+ *   TRACKS_REMOVED          <playlist> <n> <index> ...
+ *   TRACKS_MOVED            <playlist> <new position> <n> <index> ...
+ *   PLAYLIST_RENAMED        <playlist> <name>
+ *   PLAYLIST_STATE_CHANGED  <playlist> <loaded> [<n> <track> ...]
+ *   PLAYLIST_UPDATE_IN_PROGRESS  <playlist> <done>
+ *
+ * and the others nothing. <container> is <n> <playlist> ..., what the
+ * container holds when the callback comes, and a loaded playlist has
+ * its tracks, so that the replay has what the callbacks look at.
+ *
+ * Everything we number is held on to until the log is closed, so that
+ * a handle can't be freed and come back as something else.
+ *
+ * */
+
+const char *const cblog_type_names[CBLOG_NUM_TYPES] = {
+	[CBLOG_LOGGED_IN] = "logged_in",
+	[CBLOG_LOGGED_OUT] = "logged_out",
+	[CBLOG_METADATA_UPDATED] = "metadata_updated",
+	[CBLOG_CONNECTION_ERROR] = "connection_error",
+	[CBLOG_LOG_MESSAGE] = "log_message",
+	[CBLOG_NOTIFY_MAIN_THREAD] = "notify_main_thread",
+	[CBLOG_PLAYLIST_ADDED] = "playlist_added",
+	[CBLOG_PLAYLIST_REMOVED] = "playlist_removed",
+	[CBLOG_CONTAINER_LOADED] = "container_loaded",
+	[CBLOG_TRACKS_ADDED] = "tracks_added",
+	[CBLOG_TRACKS_REMOVED] = "tracks_removed",
+	[CBLOG_TRACKS_MOVED] = "tracks_moved",
+	[CBLOG_PLAYLIST_RENAMED] = "playlist_renamed",
+	[CBLOG_PLAYLIST_STATE_CHANGED] = "playlist_state_changed",
+	[CBLOG_PLAYLIST_UPDATE_IN_PROGRESS] = "playlist_update_in_progress",
+};
+
+static FILE *log_file;
+
+/// Protects everything below, libspotify calls some callbacks from its threads
+static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t last_time;
+
+/// sp_playlist* --> its number, and the same for the tracks
+static struct ptrmap playlist_ids;
+static struct ptrmap track_ids;
+static uintptr_t next_playlist_id = 1;
+static uintptr_t next_track_id = 1;
+
+
+/**
+ * Start logging the callbacks to a file, which is replaced.
+ *
+ * @return -1 if it can't be written. 0 otherwise.
+ * */
+int cblog_open(const char *path){
+	FILE *f = fopen(path, "wb");
+	if(!f){
+		fprintf(stderr, "Can't write the callback log %s\n", path);
+		return -1;
+	}
+	setvbuf(f, NULL, _IOFBF, 1 << 16);
+	fputs(CBLOG_MAGIC, f);
+	pthread_mutex_lock(&log_mutex);
+	ptrmap_init(&playlist_ids);
+	ptrmap_init(&track_ids);
+	last_time = stats_now_usec();
+	log_file = f;
+	pthread_mutex_unlock(&log_mutex);
+	return 0;
+}
+
+
+/**
+ * Stop logging, and let go of what the log numbered.
+ * */
+void cblog_close(void){
+	unsigned int iter = 0;
+	void *key, *val;
+
+	pthread_mutex_lock(&log_mutex);
+	if(!log_file){
+		pthread_mutex_unlock(&log_mutex);
+		return;
+	}
+	if(ferror(log_file) | fclose(log_file))
+		fprintf(stderr, "The callback log couldn't all be written\n");
+	log_file = NULL;
+	while(ptrmap_next(&playlist_ids, &iter, &key, &val)){
+		sp_playlist *pl = key;
+		handle_playlist_release(&pl);
+	}
+	iter = 0;
+	while(ptrmap_next(&track_ids, &iter, &key, &val)){
+		sp_track *track = key;
+		handle_track_release(&track);
+	}
+	ptrmap_free(&playlist_ids);
+	ptrmap_free(&track_ids);
+	pthread_mutex_unlock(&log_mutex);
+}
+
+
+/* ----------------------------  WRITING  ---------------------------------- */
+
+static void put_varint(uint64_t v){
+	while(v >= 0x80){
+		putc((v & 0x7f) | 0x80, log_file);
+		v >>= 7;
+	}
+	putc(v, log_file);
+}
+
+
+static void put_string(const char *s){
+	size_t n = s ? strlen(s) : 0;
+	put_varint(n);
+	fwrite(s, 1, n, log_file);
+}
+
+
+static void put_playlist(sp_playlist *pl){
+	uintptr_t id = pl ? (uintptr_t)ptrmap_get(&playlist_ids, pl) : 0;
+	char buff[256];
+	if(id || !pl){
+		put_varint(id);
+		return;
+	}
+	if(ptrmap_put(&playlist_ids, pl, (void *)next_playlist_id)){
+		put_varint(0);
+		return;
+	}
+	handle_playlist_ref(pl);
+	put_varint(next_playlist_id++);
+	playlist_to_URI(pl, buff, sizeof(buff));
+	put_string(buff);
+	put_string(sp_playlist_name(pl));
+}
+
+
+static void put_track(sp_track *track){
+	uintptr_t id = track ? (uintptr_t)ptrmap_get(&track_ids, track) : 0;
+	char buff[128];
+	if(id || !track){
+		put_varint(id);
+		return;
+	}
+	if(ptrmap_put(&track_ids, track, (void *)next_track_id)){
+		put_varint(0);
+		return;
+	}
+	handle_track_ref(track);
+	put_varint(next_track_id++);
+	track_to_URI(track, buff, sizeof(buff));
+	put_string(buff);
+}
+
+
+static void put_container(sp_playlistcontainer *pc){
+	int i, n = pc ? sp_playlistcontainer_num_playlists(pc) : 0;
+	put_varint(n);
+	for(i = 0; i < n; i++)
+		put_playlist(sp_playlistcontainer_playlist(pc, i));
+}
+
+
+static void put_indices(const int *v, int n){
+	int i;
+	put_varint(n);
+	for(i = 0; i < n; i++)
+		put_varint(v[i]);
+}
+
+
+/**
+ * Start a record, if we are logging. Unless it returns 0, finish the
+ * record with end().
+ * */
+static int begin(enum cblog_type type){
+	if(!log_file)
+		return 0;
+	pthread_mutex_lock(&log_mutex);
+	if(!log_file){
+		pthread_mutex_unlock(&log_mutex);
+		return 0;
+	}
+	uint64_t now = stats_now_usec();
+	putc(type, log_file);
+	put_varint(now - last_time);
+	last_time = now;
+	return 1;
+}
+
+
+static void end(void){
+	pthread_mutex_unlock(&log_mutex);
+}
+
+
+/* ---------------------------  CALLBACKS  --------------------------------- */
+
+void cblog_logged_in(sp_session *session, sp_error error){
+	if(!begin(CBLOG_LOGGED_IN))
+		return;
+	put_varint(error);
+	put_container(error == SP_ERROR_OK ? sp_session_playlistcontainer(session) : NULL);
+	end();
+}
+
+
+/**
+ * The session is going away, and the process with it.
+ * */
+void cblog_logged_out(void){
+	if(!begin(CBLOG_LOGGED_OUT))
+		return;
+	fflush(log_file);
+	end();
+}
+
+
+void cblog_metadata_updated(void){
+	if(!begin(CBLOG_METADATA_UPDATED))
+		return;
+	end();
+}
+
+
+void cblog_connection_error(sp_error error){
+	if(!begin(CBLOG_CONNECTION_ERROR))
+		return;
+	put_varint(error);
+	end();
+}
+
+
+void cblog_log_message(const char *data){
+	if(!begin(CBLOG_LOG_MESSAGE))
+		return;
+	put_string(data);
+	end();
+}
+
+
+void cblog_notify_main_thread(void){
+	if(!begin(CBLOG_NOTIFY_MAIN_THREAD))
+		return;
+	end();
+}
+
+
+void cblog_playlist_added(sp_playlistcontainer *pc, sp_playlist *pl, int position){
+	if(!begin(CBLOG_PLAYLIST_ADDED))
+		return;
+	put_playlist(pl);
+	put_varint(position);
+	end();
+}
+
+
+void cblog_playlist_removed(sp_playlistcontainer *pc, sp_playlist *pl, int position){
+	if(!begin(CBLOG_PLAYLIST_REMOVED))
+		return;
+	put_playlist(pl);
+	put_varint(position);
+	end();
+}
+
+
+void cblog_container_loaded(sp_playlistcontainer *pc){
+	if(!begin(CBLOG_CONTAINER_LOADED))
+		return;
+	put_container(pc);
+	end();
+}
+
+
+void cblog_tracks_added(sp_playlist *pl, sp_track * const *tracks, int n, int position){
+	int i;
+	if(!begin(CBLOG_TRACKS_ADDED))
+		return;
+	put_playlist(pl);
+	put_varint(position);
+	put_varint(n);
+	for(i = 0; i < n; i++)
+		put_track(tracks[i]);
+	end();
+}
+
+
+void cblog_tracks_removed(sp_playlist *pl, const int *tracks, int n){
+	if(!begin(CBLOG_TRACKS_REMOVED))
+		return;
+	put_playlist(pl);
+	put_indices(tracks, n);
+	end();
+}
+
+
+void cblog_tracks_moved(sp_playlist *pl, const int *tracks, int n, int new_position){
+	if(!begin(CBLOG_TRACKS_MOVED))
+		return;
+	put_playlist(pl);
+	put_varint(new_position);
+	put_indices(tracks, n);
+	end();
+}
+
+
+void cblog_playlist_renamed(sp_playlist *pl){
+	if(!begin(CBLOG_PLAYLIST_RENAMED))
+		return;
+	put_playlist(pl);
+	put_string(sp_playlist_name(pl));
+	end();
+}
+
+
+void cblog_playlist_state_changed(sp_playlist *pl){
+	int i, n;
+	if(!begin(CBLOG_PLAYLIST_STATE_CHANGED))
+		return;
+	put_playlist(pl);
+	if(!sp_playlist_is_loaded(pl)){
+		put_varint(0);
+	} else {
+		put_varint(1);
+		n = sp_playlist_num_tracks(pl);
+		put_varint(n);
+		for(i = 0; i < n; i++)
+			put_track(sp_playlist_track(pl, i));
+	}
+	end();
+}
+
+
+void cblog_playlist_update_in_progress(sp_playlist *pl, int done){
+	if(!begin(CBLOG_PLAYLIST_UPDATE_IN_PROGRESS))
+		return;
+	put_playlist(pl);
+	put_varint(done);
+	end();
+}
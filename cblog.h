@@ -0,0 +1,50 @@
+#ifndef CBLOG_H__
+#define CBLOG_H__
+
+#include <libspotify/api.h>
+
+/* The first bytes of a callback log */
+#define CBLOG_MAGIC "LFYCB01\n"
+
+/* What a record of the log is, see cblog.c for what follows each */
+enum cblog_type {
+	CBLOG_LOGGED_IN = 1,
+	CBLOG_LOGGED_OUT,
+	CBLOG_METADATA_UPDATED,
+	CBLOG_CONNECTION_ERROR,
+	CBLOG_LOG_MESSAGE,
+	CBLOG_NOTIFY_MAIN_THREAD,
+	CBLOG_PLAYLIST_ADDED,
+	CBLOG_PLAYLIST_REMOVED,
+	CBLOG_CONTAINER_LOADED,
+	CBLOG_TRACKS_ADDED,
+	CBLOG_TRACKS_REMOVED,
+	CBLOG_TRACKS_MOVED,
+	CBLOG_PLAYLIST_RENAMED,
+	CBLOG_PLAYLIST_STATE_CHANGED,
+	CBLOG_PLAYLIST_UPDATE_IN_PROGRESS,
+	CBLOG_NUM_TYPES,
+};
+
+extern const char *const cblog_type_names[CBLOG_NUM_TYPES];
+
+int cblog_open(const char *path);
+void cblog_close(void);
+
+void cblog_logged_in(sp_session *session, sp_error error);
+void cblog_logged_out(void);
+void cblog_metadata_updated(void);
+void cblog_connection_error(sp_error error);
+void cblog_log_message(const char *data);
+void cblog_notify_main_thread(void);
+void cblog_playlist_added(sp_playlistcontainer *pc, sp_playlist *pl, int position);
+void cblog_playlist_removed(sp_playlistcontainer *pc, sp_playlist *pl, int position);
+void cblog_container_loaded(sp_playlistcontainer *pc);
+void cblog_tracks_added(sp_playlist *pl, sp_track * const *tracks, int n, int position);
+void cblog_tracks_removed(sp_playlist *pl, const int *tracks, int n);
+void cblog_tracks_moved(sp_playlist *pl, const int *tracks, int n, int new_position);
+void cblog_playlist_renamed(sp_playlist *pl);
+void cblog_playlist_state_changed(sp_playlist *pl);
+void cblog_playlist_update_in_progress(sp_playlist *pl, int done);
+
+#endif
@@ -21,100 +21,929 @@
  *
  */
 
+#include <limits.h>
 #include <string.h>
 
 #include "listify.h"
 #include "cmd.h"
+#include "stats.h"
+#include "lines.h"
+#include "uri.h"
+#include "link.h"
+#include "handle.h"
+#include "nameindex.h"
+#include "timer.h"
+#include "arena.h"
+#include "pending.h"
+#include "cmdhash.h"
+#include "cmdtable.h"
 
 static int cmd_help(int argc, char **argv);
+static int cmd_check(int argc, char **argv);
+static void cmd_expired(struct timer *t);
+static void cmd_finish(int idx);
 
 /**
- *
+ * The commands, from commands.def
  */
-struct {
+static const struct {
 	const char *name;
 	int (*fn)(int argc, char **argv);
+	enum cmd_needs needs;
+	const char *args;
+	int timeout;
 	const char *help;
 } commands[] = {
-	{ "logout",       cmd_logout,         "Logout and exit app" },
-	{ "exit",         cmd_logout,         "Logout and exit app" },
-	{ "new_list",     cmd_new_playlist,   "Add a new playlist with a given name." },
-	{ "new_hide",     cmd_new_hide,       "Add a new playlist. Then hide it"},
-	{ "add_list",     cmd_add_playlist,   "Given a URI add the playlist to our container." },
-	{ "clear_list",   cmd_clear_playlist, "Clear a playlist, given it's URI" },
-	{ "add_tracks",   cmd_add_tracks,     "Add tracks to a list." },
-	{ "count_tracks", cmd_count_tracks,   "Counts the amount of tracks in a playlist." },
-	{ "hide_list",    cmd_hide_playlist,  "Hide the given playlist. (Inverse of add)"},
-	{ "help",         cmd_help,           "This help" },
+#define CMD(name, fn, needs, args, timeout, help) { #name, fn, needs, args, timeout, help },
+#include "commands.def"
+#undef CMD
+};
+
+#define NUM_COMMANDS (sizeof(commands) / sizeof(commands[0]))
+
+/*
+ * An argument of a command, checked against its letter in commands.def.
+ * Numbers, playlists and tracks are turned into what they stand for
+ * before the command is run, see cmd_run().
+ */
+struct cmd_arg {
+	char type;           // its letter, 0 for the name and the options
+	long num;            // the number of an i, -1 for the others
+	sp_playlist *pl;     // the playlist of a p
+	sp_track *track;     // the track of a t
+};
+
+/// The arguments of the running command
+static const struct cmd_arg *cmd_args;
+static int cmd_num_args;
+
+/// What the runs of each command took from the arena, see cmd_finish()
+static struct {
+	unsigned int runs;
+	unsigned long allocs;
+	unsigned long bytes;
+	unsigned long peak;
+	unsigned long grows;
+} cmd_mem[NUM_COMMANDS];
+
+/// The running command, and the options it was given, see option_bit()
+static int cmd_running = -1;
+static unsigned int cmd_opts;
+
+/*
+ * A command that returns 0 waits for a callback to finish it, which
+ * may never come. So it gets a deadline, and if it's still waiting
+ * then, it is given up on and the next command can run. Every command
+ * run gets a new token, and cmd_complete() only finishes the command
+ * whose token it's given, so a late callback of a command given up on
+ * can't finish the next one. What the command still has going is
+ * stopped by the hook it set with cmd_on_cancel(), if any.
+ * */
+
+/// The token of the last command run
+static unsigned int cmd_seq;
+
+/// The token of the command waiting to be finished, 0 if none
+static unsigned int cmd_waiting_token;
+static int cmd_waiting_idx;
+static struct timer cmd_deadline;
+
+/// What to call if the waiting command is given up on, see cmd_on_cancel()
+static cmd_cancel_fn *cmd_cancel;
+static void *cmd_cancel_data;
+
+
+/*
+ * Commands typed before we are logged in, or before the playlist
+ * container is loaded, wait here. They are run in the order they
+ * were given, one at a time, by the main loop (see cmd_queue_ready()).
+ * 
+ * */
+struct queued_cmd {
+	struct queued_cmd *next;
+	int idx;
+	int argc;
+	char args[];   // argc strings, one after the other
+};
+
+static struct queued_cmd *queue_head;
+static struct queued_cmd **queue_tail = &queue_head;
+static int queue_length;
+
+/// How far the session has come, one of the cmd_needs up to NEED_CONTAINER.
+static enum cmd_needs ready_level = NEED_NOTHING;
+
+
+/**
+ * What the commands can have now. Past the container, those that make
+ * changes wait while too many changes wait to be synced, see pending.c.
+ */
+static enum cmd_needs cmd_level(void)
+{
+	if(ready_level == NEED_CONTAINER && !pending_full())
+		return NEED_ROOM;
+	return ready_level;
+}
+
+
+/**
+ * What a queued command waits for, to tell the user.
+ */
+static const char *cmd_waits_for(enum cmd_needs needs)
+{
+	if(needs <= cmd_level())
+		return "the commands queued before it have run";
+	if(needs == NEED_SESSION)
+		return "logged in";
+	if(needs == NEED_CONTAINER || ready_level < NEED_CONTAINER)
+		return "the playlists are loaded";
+	return "fewer changes wait to be synced";
+}
+
+
+/**
+ * The words of a command line, taken one at a time from the front by
+ * next_word(). Words are split at whitespace; in '...' everything is
+ * taken as it is, in "..." everything but \" and \\, and outside of
+ * quotes a backslash takes the next character as it is. The quotes
+ * and backslashes are taken out where the word is, so a word is a
+ * pointer into the line and nothing is copied. Words can't get longer
+ * than the line, nor are there more of them than it has room for.
+ */
+struct words {
+	char *rest;          // what is still to be read
+	const char *error;   // why the line is bad, once next_word() says so
 };
 
 
 /**
+ * The next word of the line, NUL terminated in place.
  *
+ * @return NULL at the end of the line, or if it is bad, which
+ *         w->error then tells.
  */
-static int tokenize(char *buf, char **vec, int vsize)
+static char *next_word(struct words *w)
 {
-	int n = 0;
-	while(1) {
-		while(*buf > 0 && *buf < 33)
-			buf++;
-		if(!*buf)
-			break;
-		vec[n++] = buf;
-		if(n == vsize)
-			break;
-		while(*buf > 32)
-			buf++;
-		if(*buf == 0)
+	char *in = w->rest, *out, *word;
+	char quote = 0;
+
+	while(*in > 0 && *in < 33)
+		in++;
+	if(!*in) {
+		w->rest = in;
+		return NULL;
+	}
+	word = out = in;
+	while(*in) {
+		if(quote) {
+			if(*in == quote) {
+				quote = 0;
+				in++;
+				continue;
+			}
+			if(quote == '"' && *in == '\\' && (in[1] == '"' || in[1] == '\\'))
+				in++;
+		} else if(*in > 0 && *in < 33) {
+			in++;
 			break;
-		*buf = 0;
-		buf++;
+		} else if(*in == '\'' || *in == '"') {
+			quote = *in++;
+			continue;
+		} else if(*in == '\\' && in[1]) {
+			in++;
+		}
+		*out++ = *in++;
 	}
-	return n;
+	if(quote) {
+		w->error = quote == '"' ? "has a \" that is never closed" :
+		                          "has a ' that is never closed";
+		w->rest = in;
+		return NULL;
+	}
+	*out = 0;
+	w->rest = in;
+	return word;
 }
 
 
 /**
+ * Split a line into its words, in place, see struct words. The line
+ * is read once, and the words go into an array of the arena as they
+ * are found, which grows where it is as long as nothing else is taken
+ * from the arena meanwhile. So there is no limit to how many there
+ * are, other than memory.
  *
+ * @param argv gets the words, valid until the arena is reset.
+ * @return how many words, -1 if the line is bad or we ran out of memory.
+ */
+int cmd_tokenize(char *buf, char ***argv)
+{
+	struct words w = { buf, NULL };
+	char **vec = NULL, *word;
+	int n = 0, size = 0;
+
+	while((word = next_word(&w))) {
+		if(n == size) {
+			int grown = size ? size * 2 : 16;
+			char **v = arena_realloc(vec, size * sizeof(*vec), grown * sizeof(*vec));
+			if(!v) {
+				fprintf(stderr, "Out of memory.\n");
+				return -1;
+			}
+			vec = v;
+			size = grown;
+		}
+		vec[n++] = word;
+	}
+	if(w.error) {
+		fprintf(stderr, "The line %s.\n", w.error);
+		return -1;
+	}
+	*argv = vec;
+	return n;
+}
+
+
+/**
+ * Run a line as typed. The arena is reset first, for the words of
+ * this line go in it; the last command is done by now.
  */
 void cmd_exec_unparsed(char *l)
 {
-	char *vec[32];
-	int c = tokenize(l, vec, 32);
-	cmd_dispatch(c, vec);
+	char **argv;
+	int argc;
+
+	arena_reset();
+	argc = cmd_tokenize(l, &argv);
+	if(argc < 0) {
+		cmd_finish(-1);
+		return;
+	}
+	cmd_dispatch(argc, argv);
 }
 
 
 /**
- *
+ * Put a command at the end of the startup queue. Its arguments are
+ * kept one after the other, each with its NUL, as they may have
+ * spaces of their own.
  */
-void cmd_dispatch(int argc, char **argv)
+static void cmd_enqueue(int idx, int argc, char **argv)
 {
+	size_t len = 0, n;
+	char *p;
 	int i;
+	for(i = 0; i < argc; i++)
+		len += strlen(argv[i]) + 1;
 
-	if(argc < 1) {
-		cmd_done();
+	struct queued_cmd *q = malloc(sizeof(*q) + len);
+	if(!q) {
+		fprintf(stderr, "Out of memory, dropping command %s\n", argv[0]);
 		return;
 	}
+	q->next = NULL;
+	q->idx = idx;
+	q->argc = argc;
+	for(p = q->args, i = 0; i < argc; i++, p += n) {
+		n = strlen(argv[i]) + 1;
+		memcpy(p, argv[i], n);
+	}
+	*queue_tail = q;
+	queue_tail = &q->next;
+	queue_length++;
+}
+
+
+/**
+ * Find a command by its name, through the perfect hash of cmdtable.h.
+ * 
+ * @return its index in commands, -1 if there's no such command.
+ */
+static int cmd_lookup(const char *name)
+{
+	int idx = cmd_slots[cmd_hash(name, CMD_HASH_SEED) & (CMD_HASH_SIZE - 1)];
+	if(idx < 0 || strcmp(commands[idx].name, name))
+		return -1;
+	return idx;
+}
+
+
+/**
+ * Check one argument against its letter in commands.def.
+ * 
+ * @param val gets the number, if it's one.
+ * 
+ * @return NULL if it's fine, else what is wrong with it.
+ */
+static const char *check_arg(char type, const char *s, long *val)
+{
+	enum uri_kind kind = uri_parse(s, NULL);
+	char *end;
 
-	for(i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
-		if(!strcmp(commands[i].name, argv[0])) {
-			if(commands[i].fn(argc, argv))
-				cmd_done();
-			return;
+	switch(type) {
+	case 'p':
+		if(kind == URI_PLAYLIST || !strncmp(s, "name:", 5))
+			return NULL;
+		return "isn't a playlist URI or name:<pattern>";
+	case 't':
+		return kind == URI_TRACK ? NULL : "isn't a track URI";
+	case 'l':
+		return kind != URI_INVALID ? NULL : "isn't a Spotify URI";
+	case 'g':
+		if(kind == URI_PLAYLIST || !strncmp(s, "name:", 5) ||
+		   !strncmp(s, "file:", 5) || !strncmp(s, "glob:", 5))
+			return NULL;
+		return "isn't a playlist URI, name:, file: or glob:";
+	case 'i':
+		*val = strtol(s, &end, 10);
+		if(end == s || *end || *val < 0 || *val == LONG_MAX)
+			return "isn't a number";
+		return NULL;
+	default:
+		return *s ? NULL : "is empty";
+	}
+}
+
+
+/**
+ * The letters of a command in commands.def, after its options.
+ */
+static const char *arg_letters(int idx)
+{
+	const char *a = commands[idx].args;
+	while(a[0] == '-' && a[1] == '-') {
+		a += strcspn(a, " ");
+		a += strspn(a, " ");
+	}
+	return a;
+}
+
+
+/**
+ * The bit of an option of a command: 1 for the first in commands.def,
+ * 2 for the next and so on.
+ *
+ * @return 0 if it's no option of the command.
+ */
+static unsigned int option_bit(int idx, const char *opt)
+{
+	const char *a = commands[idx].args;
+	size_t n = strlen(opt);
+	unsigned int bit = 1;
+	while(a[0] == '-' && a[1] == '-') {
+		size_t len = strcspn(a, " ");
+		if(len == n && !strncmp(a, opt, n))
+			return bit;
+		bit <<= 1;
+		a += len;
+		a += strspn(a, " ");
+	}
+	return 0;
+}
+
+
+/**
+ * The options of a command come right after its name, anything else
+ * ends them.
+ *
+ * @param opts gets their bits, see option_bit().
+ *
+ * @return how many there are.
+ */
+static int take_options(int idx, int argc, char **argv, unsigned int *opts)
+{
+	unsigned int bit;
+	int i;
+	*opts = 0;
+	for(i = 1; i < argc && (bit = option_bit(idx, argv[i])); i++)
+		*opts |= bit;
+	return i - 1;
+}
+
+
+/**
+ * Check the arguments of a command against its letters in
+ * commands.def, and get the numbers among them.
+ * 
+ * @param args gets the letter and the number of each argument at its
+ *             index, may be NULL. Their pl and track are left as they
+ *             are.
+ * @param why gets what's wrong.
+ * 
+ * @return -1 if they're fine, else the index of the first bad one
+ *         (argc if some are missing).
+ */
+static int check_args(int idx, int argc, char **argv, struct cmd_arg *args, const char **why)
+{
+	const char *a = arg_letters(idx);
+	unsigned int opts;
+	int i, n = take_options(idx, argc, argv, &opts);
+
+	if(args)
+		for(i = 0; i <= n; i++) {
+			args[i].type = 0;
+			args[i].num = -1;
+		}
+	i = n + 1;
+	while(*a) {
+		char type = *a++, rep = 0;
+		int n, min, max;
+		if(*a == '?' || *a == '*' || *a == '+')
+			rep = *a++;
+		min = rep == '?' || rep == '*' ? 0 : 1;
+		max = rep == '*' || rep == '+' ? INT_MAX : 1;
+		for(n = 0; n < max && i < argc; n++, i++) {
+			long val = -1;
+			if((*why = check_arg(type, argv[i], &val)))
+				return i;
+			if(args) {
+				args[i].type = type;
+				args[i].num = type == 'i' ? val : -1;
+			}
+		}
+		if(n < min) {
+			*why = "is missing";
+			return argc;
+		}
+	}
+	if(i < argc) {
+		*why = "is one too many";
+		return i;
+	}
+	return -1;
+}
+
+
+/**
+ * Print how a command is used, from its letters in commands.def.
+ */
+static void print_usage(FILE *f, int idx)
+{
+	const char *a = commands[idx].args;
+	fprintf(f, "Usage: %s", commands[idx].name);
+	while(a[0] == '-' && a[1] == '-') {
+		int len = strcspn(a, " ");
+		fprintf(f, " [%.*s]", len, a);
+		a += len;
+		a += strspn(a, " ");
+	}
+	while(*a) {
+		const char *what;
+		switch(*a++) {
+		case 'p': what = "<URI-playlist>"; break;
+		case 't': what = "<URI-track>"; break;
+		case 'l': what = "<URI>"; break;
+		case 'g': what = "<URI | file:path | glob:pattern>"; break;
+		case 'i': what = "<number>"; break;
+		case 'f': what = "<file>"; break;
+		default:  what = "<text>"; break;
+		}
+		switch(*a) {
+		case '?': fprintf(f, " [%s]", what); a++; break;
+		case '*': fprintf(f, " [%s ...]", what); a++; break;
+		case '+': fprintf(f, " %s ...", what); a++; break;
+		default:  fprintf(f, " %s", what); break;
 		}
 	}
-	printf("No such command\n");
+	fprintf(f, "\n");
+}
+
+
+/**
+ * The number given as argument i of the running command, checked
+ * and parsed before it was run.
+ * 
+ * @return the number, or dflt if the argument was left out.
+ */
+long cmd_arg_int(int i, long dflt)
+{
+	if(!cmd_args || i >= cmd_num_args || cmd_args[i].num < 0)
+		return dflt;
+	return cmd_args[i].num;
+}
+
+
+/**
+ * The playlist given as argument i of the running command, a p in
+ * commands.def. It's only held until the command returns, take a
+ * reference to keep it longer.
+ * 
+ * @return the playlist, NULL if argument i isn't one.
+ */
+sp_playlist *cmd_arg_playlist(int i)
+{
+	if(!cmd_args || i >= cmd_num_args)
+		return NULL;
+	return cmd_args[i].pl;
+}
+
+
+/**
+ * The track given as argument i of the running command, a t in
+ * commands.def. Held as the playlists of cmd_arg_playlist() are.
+ * 
+ * @return the track, NULL if argument i isn't one.
+ */
+sp_track *cmd_arg_track(int i)
+{
+	if(!cmd_args || i >= cmd_num_args)
+		return NULL;
+	return cmd_args[i].track;
+}
+
+
+/**
+ * Tell if the running command was given an option, like "--unique".
+ */
+int cmd_option(const char *opt)
+{
+	return cmd_running >= 0 && (cmd_opts & option_bit(cmd_running, opt));
+}
+
+
+/**
+ * A command is done, or never got to run (idx -1). Count what it took
+ * from the arena, and tell the main loop.
+ */
+static void cmd_finish(int idx)
+{
+	struct arena_counts c;
+	arena_take_counts(&c);
+	if(idx >= 0) {
+		cmd_mem[idx].runs++;
+		cmd_mem[idx].allocs += c.allocs;
+		cmd_mem[idx].bytes += c.bytes;
+		cmd_mem[idx].grows += c.grows;
+		if(c.bytes > cmd_mem[idx].peak)
+			cmd_mem[idx].peak = c.bytes;
+	}
 	cmd_done();
 }
 
+
+/**
+ * Get the playlist or the track an argument stands for.
+ * 
+ * @return -1 if it can't be had.
+ */
+static int resolve_arg(struct cmd_arg *a, const char *s)
+{
+	if(a->type == 'p') {
+		a->pl = URI_to_playlist(s);
+		if(!a->pl) {
+			fprintf(stderr, "The URI %s couldn't be converted to a playlist\n", s);
+			return -1;
+		}
+	} else if(a->type == 't') {
+		SCOPED_LINK sp_link *link = handle_link(sp_link_create_from_string(s));
+		sp_track *track = link && sp_link_type(link) == SP_LINKTYPE_TRACK ?
+		                  sp_link_as_track(link) : NULL;
+		if(!track) {
+			fprintf(stderr, "The URI %s isn't a track\n", s);
+			return -1;
+		}
+		a->track = handle_track_ref(track);
+	}
+	return 0;
+}
+
+
+/**
+ * Run a command. Its options are taken out of the arguments, for
+ * cmd_option(), and any playlist argument (p or g in commands.def)
+ * "name:<pattern>" is replaced with the URI of the playlist best
+ * matching the pattern, see nameindex.c. Other arguments, like the
+ * name of a new list or a file, are left as they are.
+ * Then the numbers, playlists and tracks among the arguments are had
+ * once, for cmd_arg_int(), cmd_arg_playlist() and cmd_arg_track(), so
+ * the command itself only checks what commands.def can't say.
+ * 
+ * The arena is reset by the callers, before the arguments are put in
+ * it, see cmd_exec_unparsed().
+ */
+static void cmd_run(int idx, int argc, char **argv)
+{
+	const char *why;
+	unsigned int opts;
+	struct cmd_arg *args;
+	int i, n, r, failed = 0;
+
+	stats_command_started();
+	args = arena_calloc(argc, sizeof(*args));
+	if(!args) {
+		fprintf(stderr, "Out of memory.\n");
+		cmd_finish(idx);
+		return;
+	}
+	check_args(idx, argc, argv, args, &why);
+	n = take_options(idx, argc, argv, &opts);
+	if(n) {
+		memmove(argv + 1, argv + 1 + n, (argc - 1 - n) * sizeof(*argv));
+		memmove(args + 1, args + 1 + n, (argc - 1 - n) * sizeof(*args));
+		argc -= n;
+	}
+	for(i = 1; i < argc && !failed; i++) {
+		if((args[i].type != 'p' && args[i].type != 'g') ||
+		   strncmp(argv[i], "name:", 5))
+			continue;
+		char *URI = nameindex_resolve(argv[i] + 5);
+		if(URI)
+			argv[i] = URI;
+		else
+			failed = 1;
+	}
+	for(i = 1; i < argc && !failed; i++)
+		failed = resolve_arg(&args[i], argv[i]);
+	if(++cmd_seq == 0)
+		cmd_seq = 1;
+	cmd_args = args;
+	cmd_num_args = argc;
+	cmd_running = idx;
+	cmd_opts = opts;
+	cmd_cancel = NULL;
+	r = failed || commands[idx].fn(argc, argv);
+	cmd_args = NULL;
+	cmd_num_args = 0;
+	cmd_running = -1;
+	cmd_opts = 0;
+	for(i = 1; i < argc; i++) {
+		handle_playlist_release(&args[i].pl);
+		handle_track_release(&args[i].track);
+	}
+	if(r) {
+		cmd_cancel = NULL;
+		cmd_finish(idx);
+	} else {
+		cmd_waiting_token = cmd_seq;
+		cmd_waiting_idx = idx;
+		timer_add(&cmd_deadline, cmd_expired,
+		          commands[idx].timeout ? commands[idx].timeout : CMD_TIMEOUT_MS);
+	}
+}
+
+
+/**
+ * The token of the command running, for one that is going to return 0
+ * to hand to cmd_complete() when it's done.
+ */
+unsigned int cmd_token(void)
+{
+	return cmd_seq;
+}
+
+
+/**
+ * Tell if the command with the token is still waiting to be finished,
+ * and not given up on.
+ */
+int cmd_waiting(unsigned int token)
+{
+	return token && token == cmd_waiting_token;
+}
+
+
+/**
+ * Have fn(data) called if the command running, or waiting, is given up
+ * on, to drop whatever it still has going. It isn't called once the
+ * command is completed.
+ */
+void cmd_on_cancel(cmd_cancel_fn *fn, void *data)
+{
+	cmd_cancel = fn;
+	cmd_cancel_data = data;
+}
+
+
+/**
+ * Finish a command that returned 0. Does nothing if it was given up on.
+ */
+void cmd_complete(unsigned int token)
+{
+	if(!cmd_waiting(token))
+		return;
+	cmd_waiting_token = 0;
+	cmd_cancel = NULL;
+	timer_cancel(&cmd_deadline);
+	cmd_finish(cmd_waiting_idx);
+}
+
+
+/**
+ * The deadline of the waiting command has passed.
+ */
+static void cmd_expired(struct timer *t)
+{
+	int idx = cmd_waiting_idx;
+	int ms = commands[idx].timeout ? commands[idx].timeout : CMD_TIMEOUT_MS;
+	cmd_cancel_fn *cancel = cmd_cancel;
+	cmd_waiting_token = 0;
+	cmd_cancel = NULL;
+	fprintf(stderr, "%s: no answer in %d ms, giving up on it\n", commands[idx].name, ms);
+	if(cancel)
+		cancel(cmd_cancel_data);
+	stats_command_timed_out();
+	cmd_finish(idx);
+}
+
+
+/**
+ *
+ */
+void cmd_dispatch(int argc, char **argv)
+{
+	const char *why;
+	int i, bad;
+
+	if(argc < 1) {
+		cmd_finish(-1);
+		return;
+	}
+
+	i = cmd_lookup(argv[0]);
+	if(i < 0) {
+		printf("No such command\n");
+		cmd_finish(-1);
+		return;
+	}
+	// Bad arguments are told of at once, even if it has to wait
+	bad = check_args(i, argc, argv, NULL, &why);
+	if(bad >= 0) {
+		if(bad < argc)
+			fprintf(stderr, "%s: %s %s\n", argv[0], argv[bad], why);
+		else
+			fprintf(stderr, "%s: an argument %s\n", argv[0], why);
+		print_usage(stderr, i);
+		cmd_finish(-1);
+		return;
+	}
+	// Keep the order of everything that has to wait
+	if(commands[i].needs > cmd_level() ||
+	   (commands[i].needs != NEED_NOTHING && queue_head)) {
+		cmd_enqueue(i, argc, argv);
+		printf("Queued %s until %s\n", argv[0], cmd_waits_for(commands[i].needs));
+		cmd_finish(-1);
+		return;
+	}
+	cmd_run(i, argc, argv);
+}
+
+
+/**
+ * Tell if the first queued command can run now.
+ */
+int cmd_queue_ready(void)
+{
+	return queue_head && commands[queue_head->idx].needs <= cmd_level();
+}
+
+
+/**
+ * @return how many commands are queued.
+ */
+int cmd_queue_length(void)
+{
+	return queue_length;
+}
+
+
+/**
+ * Run the first queued command. Only call this when cmd_queue_ready()
+ * says so, and when no other command is running.
+ */
+void cmd_run_queued(void)
+{
+	struct queued_cmd *q = queue_head;
+	char **argv, *p;
+	int i;
+
+	queue_head = q->next;
+	if(!queue_head)
+		queue_tail = &queue_head;
+	queue_length--;
+
+	arena_reset();
+	argv = arena_alloc(q->argc * sizeof(*argv));
+	if(!argv) {
+		fprintf(stderr, "Out of memory, dropping command %s\n", q->args);
+		free(q);
+		cmd_finish(-1);
+		return;
+	}
+	for(p = q->args, i = 0; i < q->argc; i++, p += strlen(p) + 1)
+		argv[i] = p;
+	cmd_run(q->idx, q->argc, argv);
+	free(q);
+}
+
+
+/**
+ * Called from the logged_in callback.
+ */
+void cmd_session_ready(void)
+{
+	if(ready_level < NEED_SESSION)
+		ready_level = NEED_SESSION;
+}
+
+
+/**
+ * Called from the container_loaded callback.
+ */
+void cmd_container_ready(void)
+{
+	ready_level = NEED_CONTAINER;
+}
+
+
 /**
  *
  */
 static int cmd_help(int argc, char **argv)
 {
 	int i;
-	for(i = 0; i < sizeof(commands) / sizeof(commands[0]); i++)
+	for(i = 0; i < NUM_COMMANDS; i++)
 		printf("  %-20s %s\n", commands[i].name, commands[i].help);
 	return -1;
 }
+
+
+/**
+ * Print what the commands that have run took from the arena, for each
+ * run on average, and the most of one run. mallocs is how often the
+ * arena had to grow, which should stop once it's warm.
+ */
+void cmd_print_memory(void)
+{
+	int i;
+	printf("  %-30s %8s %8s %10s %10s %8s\n", "arena use per run", "runs",
+	       "allocs", "bytes", "most", "mallocs");
+	for(i = 0; i < NUM_COMMANDS; i++) {
+		if(!cmd_mem[i].runs)
+			continue;
+		printf("  %-30s %8u %8.1f %10.0f %10lu %8lu\n", commands[i].name,
+		       cmd_mem[i].runs, (double)cmd_mem[i].allocs / cmd_mem[i].runs,
+		       (double)cmd_mem[i].bytes / cmd_mem[i].runs, cmd_mem[i].peak,
+		       cmd_mem[i].grows);
+	}
+}
+
+
+/**
+ * Check every command of a script: that it exists and that its
+ * arguments are right. Needs neither libspotify nor a session, so
+ * it's also run by "listify --check <script>".
+ * 
+ * Each line is taken back from the arena before the next, so a long
+ * script costs no more of it than its longest line. Only what this
+ * took is, as the "check" command's own arguments are in it too.
+ * 
+ * @return the number of bad commands, -1 if the script can't be read.
+ */
+int cmd_check_script(const char *path)
+{
+	struct lines lines;
+	struct arena_mark mark;
+	const char *why;
+	char **vec;
+	int i, bad, errors = 0;
+
+	if(lines_read(path, &lines))
+		return -1;
+	arena_save(&mark);
+	for(i = 0; i < lines.num; i++) {
+		arena_rewind(&mark);
+		char *line = arena_strdup(lines.line[i]);
+		int c = cmd_tokenize(lines.line[i], &vec);
+		if(!line || c < 0) {
+			fprintf(stderr, "%s: line %d can't be read\n", path, i + 1);
+			errors++;
+			continue;
+		}
+		int idx = c ? cmd_lookup(vec[0]) : -1;
+		if(idx < 0) {
+			fprintf(stderr, "%s: %s: no such command\n", path, line);
+			errors++;
+			continue;
+		}
+		bad = check_args(idx, c, vec, NULL, &why);
+		if(bad >= 0) {
+			fprintf(stderr, "%s: %s: %s %s\n", path, line,
+			        bad < c ? vec[bad] : "an argument", why);
+			errors++;
+		}
+	}
+	arena_rewind(&mark);
+	printf("%s: %d commands, %d bad.\n", path, lines.num, errors);
+	lines_free(&lines);
+	return errors;
+}
+
+
+/**
+ * Check the commands of a script, without running them.
+ */
+static int cmd_check(int argc, char **argv)
+{
+	cmd_check_script(argv[1]);
+	return -1;
+}
@@ -24,12 +24,47 @@
 #ifndef CMD_H__
 #define CMD_H__
 
+extern int cmd_tokenize(char *buf, char ***argv);
+
 extern void cmd_exec_unparsed(char *l);
 
 extern void cmd_dispatch(int argc, char **argv);
 
 extern void cmd_done(void);
 
+/* How long a command may wait for its callback, unless commands.def says */
+#define CMD_TIMEOUT_MS 30000
+
+extern unsigned int cmd_token(void);
+extern int cmd_waiting(unsigned int token);
+extern void cmd_complete(unsigned int token);
+
+/* Called if a waiting command is given up on, see cmd_on_cancel() */
+typedef void cmd_cancel_fn(void *data);
+extern void cmd_on_cancel(cmd_cancel_fn *fn, void *data);
+
+extern long cmd_arg_int(int i, long dflt);
+extern sp_playlist *cmd_arg_playlist(int i);
+extern sp_track *cmd_arg_track(int i);
+extern int cmd_option(const char *opt);
+
+extern int cmd_check_script(const char *path);
+
+extern void cmd_print_memory(void);
+
+/* What a command has to wait for before it can run, see cmd_dispatch() */
+enum cmd_needs {
+	NEED_NOTHING,
+	NEED_SESSION,
+	NEED_CONTAINER,
+	NEED_ROOM,       // the container, and few enough changes waiting to be synced
+};
+
+extern void cmd_session_ready(void);
+extern void cmd_container_ready(void);
+extern int cmd_queue_ready(void);
+extern int cmd_queue_length(void);
+extern void cmd_run_queued(void);
 
 
 extern int cmd_logout(int argc, char **argv);
@@ -38,14 +73,38 @@ extern int cmd_new_hide(int argc, char **argv);
 extern int cmd_add_playlist(int argc, char **argv);
 extern int cmd_clear_playlist(int argc, char **argv);
 extern int cmd_add_tracks(int argc, char **argv);
+extern int cmd_append_playlist(int argc, char **argv);
+extern int cmd_insert_at(int argc, char **argv);
+extern int cmd_remove_at(int argc, char **argv);
+extern int cmd_copy_playlist(int argc, char **argv);
+extern int cmd_union_playlists(int argc, char **argv);
+extern int cmd_intersect_playlists(int argc, char **argv);
+extern int cmd_diff_playlists(int argc, char **argv);
 extern int cmd_count_tracks(int argc, char **argv);
+extern int cmd_list_tracks(int argc, char **argv);
+extern int cmd_vlist_add(int argc, char **argv);
+extern int cmd_vlist_clear(int argc, char **argv);
+extern int cmd_vlist_count(int argc, char **argv);
+extern int cmd_vlist_export(int argc, char **argv);
+extern int cmd_vlist_rebalance(int argc, char **argv);
+extern int cmd_vlist_size(int argc, char **argv);
 extern int cmd_hide_playlist(int argc, char **argv);
+extern int cmd_link_type(int argc, char **argv);
+extern int cmd_where(int argc, char **argv);
+extern int cmd_find_playlist(int argc, char **argv);
+extern int cmd_watch(int argc, char **argv);
+extern int cmd_unwatch(int argc, char **argv);
+extern int cmd_add_search(int argc, char **argv);
+extern int cmd_add_file(int argc, char **argv);
+extern int cmd_stats(int argc, char **argv);
+extern int cmd_handles(int argc, char **argv);
+extern int cmd_sync(int argc, char **argv);
 
 
 
 
 /* Shared functions */
-void browse_playlist(sp_playlist *pl);
+int browse_playlist(sp_playlist *pl, int offset, int limit);
 void print_track(sp_track *track);
 
 #endif // CMD_H__
@@ -0,0 +1,20 @@
+#ifndef CMDHASH_H__
+#define CMDHASH_H__
+
+/*
+ * The hash of the command names. mkcmdhash looks for a seed that
+ * gives every command a slot of its own, and cmd.c looks the commands
+ * up with the same function and seed, see cmdtable.h.
+ */
+static inline unsigned int cmd_hash(const char *s, unsigned int seed)
+{
+	unsigned int h = 2166136261u ^ seed;
+	while(*s) {
+		h ^= (unsigned char)*s++;
+		h *= 16777619u;
+	}
+	h ^= h >> 15;
+	return h;
+}
+
+#endif
@@ -0,0 +1,220 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "listify.h"
+#include "cmd.h"
+#include "link.h"
+#include "list.h"
+#include "lines.h"
+#include "uri.h"
+#include "handle.h"
+#include "arena.h"
+#include "pending.h"
+
+
+/*
+ * Edits at given positions, many at once, read from a file with one
+ * edit per line:
+ * 
+ *   <position> <track URI>
+ * 
+ * The positions are those of the playlist before any of the edits.
+ * The edits are sorted on position and grouped, so that every run of
+ * inserts at the same position, and every run of removals of
+ * neighbouring tracks, is one call to libspotify. The runs are done
+ * from the end of the playlist to the start, so that no run moves the
+ * tracks of another and no position has to be recomputed.
+ * 
+ * */
+
+struct edit {
+	int pos;
+	int line;          // the order in the file, to keep it for equal positions
+	sp_track *track;   // NULL if a removal didn't say which track
+};
+
+
+/**
+ * Sort on position from last to first, and on the order in the file.
+ * */
+static int edit_cmp(const void *a, const void *b){
+	const struct edit *x = a, *y = b;
+	if(x->pos != y->pos)
+		return x->pos < y->pos ? 1 : -1;
+	return x->line - y->line;
+}
+
+
+static void edits_free(struct edit *edits, int n){
+	int i;
+	for(i = 0; i < n; i++)
+		handle_track_release(&edits[i].track);
+}
+
+
+/**
+ * Read the edits of a file, and check them against the playlist.
+ * 
+ * @param need_track whether every line must have a track URI.
+ * @param out gets the edits, sorted, in the arena of the command.
+ *            Release them with edits_free().
+ * 
+ * @return the number of edits, -1 if any line is bad.
+ * */
+static int edits_read(const char *path, sp_playlist *pl, int need_track, struct edit **out){
+	struct lines lines;
+	int i, n, num = sp_playlist_num_tracks(pl);
+	// An insert may go right after the last track, a removal may not
+	int max_pos = need_track ? num : num - 1;
+
+	if(lines_read(path, &lines))
+		return -1;
+	n = lines.num;
+	struct edit *edits = arena_calloc(n ? n : 1, sizeof(struct edit));
+	if(!edits){
+		fprintf(stderr, "Out of memory.\n");
+		lines_free(&lines);
+		return -1;
+	}
+
+	for(i = 0; i < n; i++){
+		char *s = lines.line[i], *end;
+		long pos = strtol(s, &end, 10);
+		if(end == s || pos < 0 || pos > max_pos || (*end && !isspace((unsigned char)*end))){
+			fprintf(stderr, "Nothing was changed, bad position on the line: %s\n", s);
+			goto fail;
+		}
+		while(isspace((unsigned char)*end))
+			end++;
+		edits[i].pos = pos;
+		edits[i].line = i;
+		if(!*end && !need_track)
+			continue;
+		if(uri_parse(end, NULL) != URI_TRACK){
+			fprintf(stderr, "Nothing was changed, no track URI on the line: %s\n", s);
+			goto fail;
+		}
+		SCOPED_LINK sp_link *link = handle_link(sp_link_create_from_string(end));
+		sp_track *track = link ? sp_link_as_track(link) : NULL;
+		if(!track){
+			fprintf(stderr, "Nothing was changed, couldn't get the track %s\n", end);
+			goto fail;
+		}
+		edits[i].track = handle_track_ref(track);
+		if(!need_track && sp_playlist_track(pl, pos) != track){
+			fprintf(stderr, "Nothing was changed, %s isn't at position %ld\n", end, pos);
+			goto fail;
+		}
+	}
+	lines_free(&lines);
+	qsort(edits, n, sizeof(struct edit), edit_cmp);
+	*out = edits;
+	return n;
+
+fail:
+	lines_free(&lines);
+	edits_free(edits, n);
+	return -1;
+}
+
+
+/**
+ * Insert tracks at many positions.
+ * 
+ * @param 1
+ * The full URI of the playlist.
+ * @param 2
+ * A file with a position and a track URI on each line. The track goes
+ * before the track that was at the position, at the end if it's the
+ * number of tracks. Tracks with the same position go in the order of
+ * the file.
+ * 
+ * @return -1.
+ * */
+int cmd_insert_at(int argc, char **argv){
+	sp_playlist *pl = cmd_arg_playlist(1);
+	if(!sp_playlist_is_loaded(pl)){
+		fprintf(stderr, "The playlist isn't loaded yet, try again.\n");
+		return -1;
+	}
+	struct edit *edits;
+	int n = edits_read(argv[2], pl, 1, &edits);
+	if(n < 0)
+		return -1;
+
+	sp_track **run = arena_alloc((n ? n : 1) * sizeof(sp_track*));
+	int i, j, calls = 0, done = 0;
+	if(!run){
+		fprintf(stderr, "Out of memory.\n");
+		edits_free(edits, n);
+		return -1;
+	}
+	for(i = 0; i < n; i = j){
+		for(j = i; j < n && edits[j].pos == edits[i].pos; j++)
+			run[j - i] = edits[j].track;
+		sp_error err = add_tracks_chunked(pl, run, j - i, edits[i].pos);
+		if(err != SP_ERROR_OK){
+			fprintf(stderr, "Error '%s' when inserting at %d, stopped there.\n", sp_error_message(err), edits[i].pos);
+			break;
+		}
+		calls++;
+		done = j;
+	}
+	printf("Inserted %d tracks at %d positions.\n", done, calls);
+	edits_free(edits, n);
+	return -1;
+}
+
+
+/**
+ * Remove the tracks at many positions.
+ * 
+ * @param 1
+ * The full URI of the playlist.
+ * @param 2
+ * A file with a position on each line, and optionally the URI of the
+ * track that should be there. Nothing is removed if any of them isn't.
+ * 
+ * @return -1.
+ * */
+int cmd_remove_at(int argc, char **argv){
+	sp_playlist *pl = cmd_arg_playlist(1);
+	if(!sp_playlist_is_loaded(pl)){
+		fprintf(stderr, "The playlist isn't loaded yet, try again.\n");
+		return -1;
+	}
+	struct edit *edits;
+	int n = edits_read(argv[2], pl, 0, &edits);
+	if(n < 0)
+		return -1;
+
+	int *run = arena_alloc((n ? n : 1) * sizeof(int));
+	int i, j, k, calls = 0, done = 0;
+	if(!run){
+		fprintf(stderr, "Out of memory.\n");
+		edits_free(edits, n);
+		return -1;
+	}
+	for(i = 0; i < n; i = j){
+		// A run of neighbours, each position once, lowest first
+		k = 0;
+		for(j = i; j < n && edits[j].pos >= edits[i].pos - k; j++)
+			if(edits[j].pos == edits[i].pos - k)
+				k++;
+		int first = edits[i].pos - k + 1;
+		for(k = 0; first + k <= edits[i].pos; k++)
+			run[k] = first + k;
+		sp_error err = sp_playlist_remove_tracks(pl, run, k);
+		if(err != SP_ERROR_OK){
+			fprintf(stderr, "Error '%s' when removing at %d, stopped there.\n", sp_error_message(err), first);
+			break;
+		}
+		pending_changed(pl, k);
+		calls++;
+		done += k;
+	}
+	printf("Removed %d tracks in %d runs.\n", done, calls);
+	edits_free(edits, n);
+	return -1;
+}
@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "listify.h"
+#include "ptrmap.h"
+#include "handle.h"
+#include "expand.h"
+
+
+/*
+ * Expansion of albums and artists into their tracks, through
+ * sp_albumbrowse_create() and sp_artistbrowse_create().
+ * 
+ * Every expansion is kept for the rest of the session, keyed on the
+ * album or artist handle. If the same album is asked for while it's
+ * still being browsed, the second caller waits on the first browse
+ * rather than starting another one.
+ * 
+ * */
+
+struct waiter {
+	struct waiter *next;
+	expand_cb *cb;
+	void *userdata;
+};
+
+struct expansion {
+	void *key;            // the album or the artist
+	int is_artist;
+	int loading;
+	int num_tracks;       // -1 if the browse failed
+	sp_track **tracks;
+	struct waiter *waiters;
+};
+
+/// Album and artist handles --> struct expansion
+static struct ptrmap expansions;
+
+
+/**
+ * Tell everyone waiting. Failures aren't kept, so that the next
+ * caller tries again.
+ * */
+static void expansion_done(struct expansion *e){
+	e->loading = 0;
+	while(e->waiters){
+		struct waiter *w = e->waiters;
+		e->waiters = w->next;
+		w->cb(e->tracks, e->num_tracks, w->userdata);
+		free(w);
+	}
+	if(e->num_tracks < 0){
+		ptrmap_remove(&expansions, e->key);
+		if(e->is_artist)
+			sp_artist_release(e->key);
+		else
+			sp_album_release(e->key);
+		free(e->tracks);
+		free(e);
+	}
+}
+
+
+/**
+ * Keep the tracks the browse gave us. They get a reference each,
+ * since the browse result is released right after.
+ * */
+static void expansion_fill(struct expansion *e, int n, sp_track *(*get)(void *, int), void *browse){
+	e->tracks = malloc((n > 0 ? n : 1) * sizeof(sp_track*));
+	if(!e->tracks){
+		fprintf(stderr, "Out of memory when expanding %d tracks.\n", n);
+		e->num_tracks = -1;
+		return;
+	}
+	int i;
+	for(i = 0; i < n; i++)
+		e->tracks[i] = handle_track_ref(get(browse, i));
+	e->num_tracks = n;
+}
+
+
+static sp_track *albumbrowse_track(void *browse, int i){
+	return sp_albumbrowse_track(browse, i);
+}
+
+
+static sp_track *artistbrowse_track(void *browse, int i){
+	return sp_artistbrowse_track(browse, i);
+}
+
+
+static void albumbrowse_complete(sp_albumbrowse *browse, void *userdata){
+	struct expansion *e = userdata;
+	sp_error err = sp_albumbrowse_error(browse);
+	if(err == SP_ERROR_OK){
+		expansion_fill(e, sp_albumbrowse_num_tracks(browse), &albumbrowse_track, browse);
+	} else {
+		fprintf(stderr, "Error '%s' when browsing an album.\n", sp_error_message(err));
+		e->num_tracks = -1;
+	}
+	sp_albumbrowse_release(browse);
+	expansion_done(e);
+}
+
+
+static void artistbrowse_complete(sp_artistbrowse *browse, void *userdata){
+	struct expansion *e = userdata;
+	sp_error err = sp_artistbrowse_error(browse);
+	if(err == SP_ERROR_OK){
+		expansion_fill(e, sp_artistbrowse_num_tracks(browse), &artistbrowse_track, browse);
+	} else {
+		fprintf(stderr, "Error '%s' when browsing an artist.\n", sp_error_message(err));
+		e->num_tracks = -1;
+	}
+	sp_artistbrowse_release(browse);
+	expansion_done(e);
+}
+
+
+/**
+ * Find the expansion for key, or make a new one that is loading.
+ * 
+ * @param key the album or artist.
+ * @param created set to 1 if the caller has to start the browse.
+ * */
+static struct expansion *expansion_get(void *key, int *created){
+	struct expansion *e = ptrmap_get(&expansions, key);
+	*created = 0;
+	if(e)
+		return e;
+	e = calloc(1, sizeof(*e));
+	if(!e || ptrmap_put(&expansions, key, e)){
+		free(e);
+		return NULL;
+	}
+	e->key = key;
+	e->loading = 1;
+	*created = 1;
+	return e;
+}
+
+
+/**
+ * Give cb the tracks of e, now or when the browse is done.
+ * 
+ * @return 1 if cb was called already, 0 if it will be, -1 if out of memory.
+ * */
+static int expansion_wait(struct expansion *e, expand_cb *cb, void *userdata){
+	if(!e->loading){
+		cb(e->tracks, e->num_tracks, userdata);
+		return 1;
+	}
+	struct waiter *w = malloc(sizeof(*w));
+	if(!w)
+		return -1;
+	w->cb = cb;
+	w->userdata = userdata;
+	w->next = e->waiters;
+	e->waiters = w;
+	return 0;
+}
+
+
+/**
+ * Get the tracks of an album.
+ * 
+ * @return 1 if cb was called already, 0 if it will be, -1 if it failed.
+ * */
+int expand_album(sp_album *album, expand_cb *cb, void *userdata){
+	int created;
+	struct expansion *e = expansion_get(album, &created);
+	if(!e){
+		fprintf(stderr, "Out of memory when expanding an album.\n");
+		return -1;
+	}
+	if(created){
+		sp_album_add_ref(album); // it's our key now
+		if(!sp_albumbrowse_create(g_session, album, &albumbrowse_complete, e)){
+			fprintf(stderr, "Couldn't browse the album.\n");
+			ptrmap_remove(&expansions, album);
+			sp_album_release(album);
+			free(e);
+			return -1;
+		}
+	}
+	return expansion_wait(e, cb, userdata);
+}
+
+
+/**
+ * Get the tracks of an artist.
+ * 
+ * @return 1 if cb was called already, 0 if it will be, -1 if it failed.
+ * */
+int expand_artist(sp_artist *artist, expand_cb *cb, void *userdata){
+	int created;
+	struct expansion *e = expansion_get(artist, &created);
+	if(!e){
+		fprintf(stderr, "Out of memory when expanding an artist.\n");
+		return -1;
+	}
+	if(created){
+		sp_artist_add_ref(artist);
+		e->is_artist = 1;
+		if(!sp_artistbrowse_create(g_session, artist, &artistbrowse_complete, e)){
+			fprintf(stderr, "Couldn't browse the artist.\n");
+			ptrmap_remove(&expansions, artist);
+			sp_artist_release(artist);
+			free(e);
+			return -1;
+		}
+	}
+	return expansion_wait(e, cb, userdata);
+}
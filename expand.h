@@ -0,0 +1,16 @@
+#ifndef EXPAND_H__
+#define EXPAND_H__
+
+#include <libspotify/api.h>
+
+/*
+ * Called with the tracks of an album or artist, num_tracks is -1 if
+ * the browse failed. The tracks belong to the cache and stay valid
+ * for the rest of the session.
+ */
+typedef void expand_cb(sp_track **tracks, int num_tracks, void *userdata);
+
+int expand_album(sp_album *album, expand_cb *cb, void *userdata);
+int expand_artist(sp_artist *artist, expand_cb *cb, void *userdata);
+
+#endif
@@ -0,0 +1,911 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libspotify/api.h>
+#include "uri.h"
+#include "fakespotify.h"
+
+
+/*
+ * A stand-in for the parts of libspotify that listify uses, kept in
+ * memory, for loadgen.c and whatever else has to run listify without
+ * Spotify. It knows tracks and playlists only: any well formed track
+ * or playlist URI is one, created the first time it's asked for, and
+ * every playlist is loaded and empty when it is created. Albums,
+ * artists and searches are never found.
+ *
+ * Login and the loading of the container are told of from
+ * sp_session_process_events(), like libspotify does. Changes to
+ * playlists and to the container are told of right away, from the
+ * call that made them, so a command that waits for them is done
+ * when it returns. A changed playlist has pending changes until the
+ * next sp_session_process_events(), which syncs them all and tells
+ * with playlist_state_changed.
+ *
+ * Nothing is ever freed but links, a run is short.
+ *
+ * The fake_ functions at the end make the stand-in look like what a
+ * callback log says, and give its callbacks, for replay.c.
+ *
+ * */
+
+/// How many ms sp_session_process_events() says to wait, when idle
+#define FAKE_IDLE_MS 1000
+
+/// Buckets of the track and playlist tables, a power of two
+#define FAKE_BUCKETS 65536
+
+struct sp_track {
+	struct sp_track *hnext;
+	struct spid id;
+	char name[8 + SPID_LENGTH];
+};
+
+struct playlist_cb {
+	sp_playlist_callbacks *cb;
+	void *userdata;
+};
+
+struct sp_playlist {
+	struct sp_playlist *hnext;
+	struct spid id;
+	char *user;
+	char *name;
+	sp_track **tracks;
+	int num;
+	int cap;
+	int in_container;
+	int loading;
+	struct playlist_cb *cbs;
+	int num_cbs;
+	int pending;                    // has changes not yet synced
+	struct sp_playlist *next_pending;
+};
+
+struct container_cb {
+	sp_playlistcontainer_callbacks *cb;
+	void *userdata;
+};
+
+struct sp_playlistcontainer {
+	sp_playlist **v;
+	int num;
+	int cap;
+	int loaded;
+	struct container_cb *cbs;
+	int num_cbs;
+};
+
+struct sp_user {
+	char name[256];
+};
+
+struct sp_session {
+	const sp_session_callbacks *cb;
+	struct sp_user user;
+	struct sp_playlistcontainer pc;
+	int logged_in;
+	int login_pending;
+	int logout_pending;
+};
+
+struct sp_link {
+	enum uri_kind kind;
+	struct spid id;
+	char user[256];
+};
+
+static sp_track *tracks[FAKE_BUCKETS];
+static sp_playlist *playlists[FAKE_BUCKETS];
+
+/// For the ids of new playlists
+static unsigned long long playlist_seq;
+
+/// Set by fake_hold_events()
+static int held;
+
+/// The session, to wake up when there are changes to sync
+static sp_session *session;
+
+/// The playlists with pending changes
+static sp_playlist *unsynced;
+
+
+static unsigned int bucket(const struct spid *id){
+	uint64_t h = (id->lo ^ id->hi * 0x9e3779b97f4a7c15ULL) * 0xff51afd7ed558ccdULL;
+	return (h >> 32) & (FAKE_BUCKETS - 1);
+}
+
+
+static void *must(void *p){
+	if(!p){
+		fprintf(stderr, "fakespotify: out of memory\n");
+		abort();
+	}
+	return p;
+}
+
+
+/* ------------------------------- SESSION ---------------------------------- */
+
+sp_error sp_session_init(const sp_session_config *config, sp_session **sess){
+	if(config->api_version != SPOTIFY_API_VERSION)
+		return SP_ERROR_BAD_API_VERSION;
+	sp_session *s = must(calloc(1, sizeof(*s)));
+	s->cb = config->callbacks;
+	session = s;
+	*sess = s;
+	return SP_ERROR_OK;
+}
+
+
+static void notify(sp_session *s){
+	if(s->cb->notify_main_thread)
+		s->cb->notify_main_thread(s);
+}
+
+
+sp_error sp_session_login(sp_session *s, const char *username, const char *password){
+	snprintf(s->user.name, sizeof(s->user.name), "%s", username);
+	s->login_pending = 1;
+	notify(s);
+	return SP_ERROR_OK;
+}
+
+
+sp_error sp_session_logout(sp_session *s){
+	s->logout_pending = 1;
+	notify(s);
+	return SP_ERROR_OK;
+}
+
+
+void sp_session_process_events(sp_session *s, int *next_timeout){
+	int i;
+	*next_timeout = FAKE_IDLE_MS;
+	if(held)
+		return;
+	if(s->login_pending){
+		s->login_pending = 0;
+		s->logged_in = 1;
+		if(s->cb->logged_in)
+			s->cb->logged_in(s, SP_ERROR_OK);
+	}
+	if(s->logged_in && !s->pc.loaded){
+		s->pc.loaded = 1;
+		for(i = 0; i < s->pc.num_cbs; i++)
+			if(s->pc.cbs[i].cb->container_loaded)
+				s->pc.cbs[i].cb->container_loaded(&s->pc, s->pc.cbs[i].userdata);
+	}
+	while(unsynced){
+		sp_playlist *pl = unsynced;
+		unsynced = pl->next_pending;
+		pl->pending = 0;
+		for(i = 0; i < pl->num_cbs; i++)
+			if(pl->cbs[i].cb->playlist_state_changed)
+				pl->cbs[i].cb->playlist_state_changed(pl, pl->cbs[i].userdata);
+	}
+	if(s->logout_pending){
+		s->logout_pending = 0;
+		s->logged_in = 0;
+		if(s->cb->logged_out)
+			s->cb->logged_out(s);
+	}
+}
+
+
+sp_user *sp_session_user(sp_session *s){
+	return s->logged_in ? &s->user : NULL;
+}
+
+
+sp_playlistcontainer *sp_session_playlistcontainer(sp_session *s){
+	return &s->pc;
+}
+
+
+bool sp_user_is_loaded(sp_user *user){
+	return 1;
+}
+
+
+const char *sp_user_display_name(sp_user *user){
+	return user->name;
+}
+
+
+const char *sp_user_canonical_name(sp_user *user){
+	return user->name;
+}
+
+
+const char *sp_error_message(sp_error error){
+	switch(error){
+	case SP_ERROR_OK:               return "No error";
+	case SP_ERROR_BAD_API_VERSION:  return "Invalid library version";
+	case SP_ERROR_INVALID_INDATA:   return "Invalid input";
+	case SP_ERROR_IS_LOADING:       return "Resource not loaded yet";
+	case SP_ERROR_OTHER_PERMANENT:  return "Not found in the stand-in";
+	default:                        return "Unknown error";
+	}
+}
+
+
+/* -------------------------------- TRACKS ---------------------------------- */
+
+static sp_track *track_get(const struct spid *id){
+	unsigned int b = bucket(id);
+	sp_track *t;
+	for(t = tracks[b]; t; t = t->hnext)
+		if(spid_equal(&t->id, id))
+			return t;
+	t = must(calloc(1, sizeof(*t)));
+	t->id = *id;
+	strcpy(t->name, "Track ");
+	spid_encode(id, t->name + 6);
+	t->hnext = tracks[b];
+	tracks[b] = t;
+	return t;
+}
+
+
+// Tracks live as long as the process, so the references aren't counted
+void sp_track_add_ref(sp_track *track){
+}
+
+
+void sp_track_release(sp_track *track){
+}
+
+
+sp_error sp_track_error(sp_track *track){
+	return SP_ERROR_OK;
+}
+
+
+const char *sp_track_name(sp_track *track){
+	return track->name;
+}
+
+
+int sp_track_duration(sp_track *track){
+	return 120000 + track->id.lo % 240000;
+}
+
+
+int sp_track_num_artists(sp_track *track){
+	return 0;
+}
+
+
+sp_artist *sp_track_artist(sp_track *track, int index){
+	return NULL;
+}
+
+
+/* ------------------------ ALBUMS, ARTISTS, SEARCHES ----------------------- */
+
+void sp_album_add_ref(sp_album *album){
+}
+
+
+void sp_album_release(sp_album *album){
+}
+
+
+void sp_artist_add_ref(sp_artist *artist){
+}
+
+
+void sp_artist_release(sp_artist *artist){
+}
+
+
+const char *sp_artist_name(sp_artist *artist){
+	return "";
+}
+
+
+sp_albumbrowse *sp_albumbrowse_create(sp_session *s, sp_album *album,
+                                      albumbrowse_complete_cb *callback, void *userdata){
+	return NULL;
+}
+
+
+sp_error sp_albumbrowse_error(sp_albumbrowse *alb){
+	return SP_ERROR_OTHER_PERMANENT;
+}
+
+
+int sp_albumbrowse_num_tracks(sp_albumbrowse *alb){
+	return 0;
+}
+
+
+sp_track *sp_albumbrowse_track(sp_albumbrowse *alb, int index){
+	return NULL;
+}
+
+
+void sp_albumbrowse_release(sp_albumbrowse *alb){
+}
+
+
+sp_artistbrowse *sp_artistbrowse_create(sp_session *s, sp_artist *artist,
+                                        artistbrowse_complete_cb *callback, void *userdata){
+	return NULL;
+}
+
+
+sp_error sp_artistbrowse_error(sp_artistbrowse *arb){
+	return SP_ERROR_OTHER_PERMANENT;
+}
+
+
+int sp_artistbrowse_num_tracks(sp_artistbrowse *arb){
+	return 0;
+}
+
+
+sp_track *sp_artistbrowse_track(sp_artistbrowse *arb, int index){
+	return NULL;
+}
+
+
+void sp_artistbrowse_release(sp_artistbrowse *arb){
+}
+
+
+sp_search *sp_search_create(sp_session *s, const char *query, int track_offset,
+                            int track_count, int album_offset, int album_count,
+                            int artist_offset, int artist_count,
+                            search_complete_cb *callback, void *userdata){
+	return NULL;
+}
+
+
+sp_error sp_search_error(sp_search *search){
+	return SP_ERROR_OTHER_PERMANENT;
+}
+
+
+int sp_search_num_tracks(sp_search *search){
+	return 0;
+}
+
+
+sp_track *sp_search_track(sp_search *search, int index){
+	return NULL;
+}
+
+
+void sp_search_release(sp_search *search){
+}
+
+
+/* ------------------------------- PLAYLISTS -------------------------------- */
+
+static sp_playlist *playlist_new(const struct spid *id, const char *user, const char *name){
+	unsigned int b = bucket(id);
+	sp_playlist *pl = must(calloc(1, sizeof(*pl)));
+	pl->id = *id;
+	pl->user = must(strdup(user));
+	pl->name = must(strdup(name));
+	pl->hnext = playlists[b];
+	playlists[b] = pl;
+	return pl;
+}
+
+
+static sp_playlist *playlist_get(const struct spid *id, const char *user){
+	sp_playlist *pl;
+	for(pl = playlists[bucket(id)]; pl; pl = pl->hnext)
+		if(spid_equal(&pl->id, id))
+			return pl;
+	char name[SPID_LENGTH + 1];
+	spid_encode(id, name);
+	return playlist_new(id, user, name);
+}
+
+
+sp_playlist *sp_playlist_create(sp_session *s, sp_link *link){
+	if(link->kind != URI_PLAYLIST)
+		return NULL;
+	return playlist_get(&link->id, link->user);
+}
+
+
+// Playlists live as long as the process, so the references aren't counted
+void sp_playlist_add_ref(sp_playlist *pl){
+}
+
+
+void sp_playlist_release(sp_playlist *pl){
+}
+
+
+bool sp_playlist_is_loaded(sp_playlist *pl){
+	return !pl->loading;
+}
+
+
+const char *sp_playlist_name(sp_playlist *pl){
+	return pl->name;
+}
+
+
+int sp_playlist_num_tracks(sp_playlist *pl){
+	return pl->num;
+}
+
+
+sp_track *sp_playlist_track(sp_playlist *pl, int index){
+	if(index < 0 || index >= pl->num)
+		return NULL;
+	return pl->tracks[index];
+}
+
+
+void sp_playlist_add_callbacks(sp_playlist *pl, sp_playlist_callbacks *callbacks, void *userdata){
+	pl->cbs = must(realloc(pl->cbs, (pl->num_cbs + 1) * sizeof(*pl->cbs)));
+	pl->cbs[pl->num_cbs].cb = callbacks;
+	pl->cbs[pl->num_cbs].userdata = userdata;
+	pl->num_cbs++;
+}
+
+
+void sp_playlist_remove_callbacks(sp_playlist *pl, sp_playlist_callbacks *callbacks, void *userdata){
+	int i;
+	for(i = 0; i < pl->num_cbs; i++){
+		if(pl->cbs[i].cb == callbacks && pl->cbs[i].userdata == userdata){
+			pl->cbs[i] = pl->cbs[--pl->num_cbs];
+			return;
+		}
+	}
+}
+
+
+bool sp_playlist_has_pending_changes(sp_playlist *pl){
+	return pl->pending;
+}
+
+
+/**
+ * A change was made to the playlist, which the next
+ * sp_session_process_events() syncs.
+ */
+static void changed(sp_playlist *pl){
+	if(pl->pending)
+		return;
+	pl->pending = 1;
+	pl->next_pending = unsynced;
+	unsynced = pl;
+	if(session)
+		notify(session);
+}
+
+
+static void tracks_insert(sp_playlist *pl, sp_track * const *add, int n, int position){
+	if(pl->num + n > pl->cap){
+		pl->cap = (pl->num + n) * 2;
+		pl->tracks = must(realloc(pl->tracks, pl->cap * sizeof(*pl->tracks)));
+	}
+	memmove(pl->tracks + position + n, pl->tracks + position,
+	        (pl->num - position) * sizeof(*pl->tracks));
+	memcpy(pl->tracks + position, add, n * sizeof(*pl->tracks));
+	pl->num += n;
+}
+
+
+/**
+ * Take out the tracks at the given indices, ignoring those that
+ * aren't in the playlist.
+ */
+static void tracks_delete(sp_playlist *pl, const int *remove, int n){
+	int i, j;
+	if(!pl->num)
+		return;
+	char *gone = must(calloc(pl->num, 1));
+	for(i = 0; i < n; i++)
+		if(remove[i] >= 0 && remove[i] < pl->num)
+			gone[remove[i]] = 1;
+	for(i = j = 0; i < pl->num; i++)
+		if(!gone[i])
+			pl->tracks[j++] = pl->tracks[i];
+	pl->num = j;
+	free(gone);
+}
+
+
+sp_error sp_playlist_add_tracks(sp_playlist *pl, const sp_track **add, int n,
+                                int position, sp_session *s){
+	int i;
+	if(n < 0 || position < 0 || position > pl->num)
+		return SP_ERROR_INVALID_INDATA;
+	for(i = 0; i < n; i++)
+		if(!add[i])
+			return SP_ERROR_INVALID_INDATA;
+	tracks_insert(pl, (sp_track * const *)add, n, position);
+	changed(pl);
+	for(i = 0; i < pl->num_cbs; i++)
+		if(pl->cbs[i].cb->tracks_added)
+			pl->cbs[i].cb->tracks_added(pl, pl->tracks + position, n, position,
+			                            pl->cbs[i].userdata);
+	return SP_ERROR_OK;
+}
+
+
+sp_error sp_playlist_remove_tracks(sp_playlist *pl, const int *remove, int n){
+	int i;
+	if(n < 0)
+		return SP_ERROR_INVALID_INDATA;
+	for(i = 0; i < n; i++)
+		if(remove[i] < 0 || remove[i] >= pl->num)
+			return SP_ERROR_INVALID_INDATA;
+	if(!n)
+		return SP_ERROR_OK;
+	tracks_delete(pl, remove, n);
+	changed(pl);
+	for(i = 0; i < pl->num_cbs; i++)
+		if(pl->cbs[i].cb->tracks_removed)
+			pl->cbs[i].cb->tracks_removed(pl, remove, n, pl->cbs[i].userdata);
+	return SP_ERROR_OK;
+}
+
+
+/* ------------------------------- CONTAINER -------------------------------- */
+
+void sp_playlistcontainer_add_callbacks(sp_playlistcontainer *pc,
+                                        sp_playlistcontainer_callbacks *callbacks,
+                                        void *userdata){
+	pc->cbs = must(realloc(pc->cbs, (pc->num_cbs + 1) * sizeof(*pc->cbs)));
+	pc->cbs[pc->num_cbs].cb = callbacks;
+	pc->cbs[pc->num_cbs].userdata = userdata;
+	pc->num_cbs++;
+}
+
+
+int sp_playlistcontainer_num_playlists(sp_playlistcontainer *pc){
+	return pc->num;
+}
+
+
+sp_playlist *sp_playlistcontainer_playlist(sp_playlistcontainer *pc, int index){
+	if(index < 0 || index >= pc->num)
+		return NULL;
+	return pc->v[index];
+}
+
+
+static void container_insert(sp_playlistcontainer *pc, sp_playlist *pl, int position){
+	if(pc->num == pc->cap){
+		pc->cap = pc->cap ? pc->cap * 2 : 64;
+		pc->v = must(realloc(pc->v, pc->cap * sizeof(*pc->v)));
+	}
+	memmove(pc->v + position + 1, pc->v + position, (pc->num - position) * sizeof(*pc->v));
+	pc->v[position] = pl;
+	pc->num++;
+	pl->in_container = 1;
+}
+
+
+static void container_delete(sp_playlistcontainer *pc, int index){
+	pc->v[index]->in_container = 0;
+	memmove(pc->v + index, pc->v + index + 1, (pc->num - index - 1) * sizeof(*pc->v));
+	pc->num--;
+}
+
+
+static void fire_playlist_added(sp_playlistcontainer *pc, sp_playlist *pl, int position){
+	int i;
+	for(i = 0; i < pc->num_cbs; i++)
+		if(pc->cbs[i].cb->playlist_added)
+			pc->cbs[i].cb->playlist_added(pc, pl, position, pc->cbs[i].userdata);
+}
+
+
+static void fire_playlist_removed(sp_playlistcontainer *pc, sp_playlist *pl, int position){
+	int i;
+	for(i = 0; i < pc->num_cbs; i++)
+		if(pc->cbs[i].cb->playlist_removed)
+			pc->cbs[i].cb->playlist_removed(pc, pl, position, pc->cbs[i].userdata);
+}
+
+
+static sp_playlist *container_append(sp_playlistcontainer *pc, sp_playlist *pl){
+	container_insert(pc, pl, pc->num);
+	fire_playlist_added(pc, pl, pc->num - 1);
+	return pl;
+}
+
+
+sp_playlist *sp_playlistcontainer_add_new_playlist(sp_playlistcontainer *pc, const char *name){
+	sp_session *s = (sp_session *)((char *)pc - offsetof(sp_session, pc));
+	struct spid id = { 0x6e6577, ++playlist_seq }; // "new"
+	if(!name || !*name || strlen(name) > 255)
+		return NULL;
+	return container_append(pc, playlist_new(&id, s->user.name, name));
+}
+
+
+sp_playlist *sp_playlistcontainer_add_playlist(sp_playlistcontainer *pc, sp_link *link){
+	if(link->kind != URI_PLAYLIST)
+		return NULL;
+	sp_playlist *pl = playlist_get(&link->id, link->user);
+	if(pl->in_container)
+		return NULL;
+	return container_append(pc, pl);
+}
+
+
+sp_error sp_playlistcontainer_remove_playlist(sp_playlistcontainer *pc, int index){
+	if(index < 0 || index >= pc->num)
+		return SP_ERROR_INVALID_INDATA;
+	sp_playlist *pl = pc->v[index];
+	container_delete(pc, index);
+	fire_playlist_removed(pc, pl, index);
+	return SP_ERROR_OK;
+}
+
+
+/* --------------------------------- LINKS ---------------------------------- */
+
+static sp_link *link_new(enum uri_kind kind, const struct spid *id, const char *user){
+	sp_link *link = must(calloc(1, sizeof(*link)));
+	link->kind = kind;
+	link->id = *id;
+	if(user)
+		snprintf(link->user, sizeof(link->user), "%s", user);
+	return link;
+}
+
+
+sp_link *sp_link_create_from_string(const char *link){
+	struct uri u;
+	if(uri_parse(link, &u) == URI_INVALID)
+		return NULL;
+	sp_link *l = link_new(u.kind, &u.id, NULL);
+	if(u.kind == URI_PLAYLIST)
+		snprintf(l->user, sizeof(l->user), "%.*s", u.user_len, u.user);
+	return l;
+}
+
+
+sp_link *sp_link_create_from_track(sp_track *track, int offset){
+	return link_new(URI_TRACK, &track->id, NULL);
+}
+
+
+sp_link *sp_link_create_from_playlist(sp_playlist *pl){
+	return link_new(URI_PLAYLIST, &pl->id, pl->user);
+}
+
+
+void sp_link_release(sp_link *link){
+	free(link);
+}
+
+
+sp_linktype sp_link_type(sp_link *link){
+	switch(link->kind){
+	case URI_TRACK:    return SP_LINKTYPE_TRACK;
+	case URI_ALBUM:    return SP_LINKTYPE_ALBUM;
+	case URI_ARTIST:   return SP_LINKTYPE_ARTIST;
+	case URI_PLAYLIST: return SP_LINKTYPE_PLAYLIST;
+	default:           return SP_LINKTYPE_INVALID;
+	}
+}
+
+
+/**
+ * Like snprintf(), the length of the whole URI is returned even if
+ * only part of it fit.
+ */
+int sp_link_as_string(sp_link *link, char *buffer, int buffer_size){
+	struct uri u;
+	char buf[300];
+	u.kind = link->kind;
+	u.id = link->id;
+	u.user = link->user;
+	u.user_len = strlen(link->user);
+	int n = uri_format(&u, buf, sizeof(buf));
+	if(n < 0)
+		n = 0;
+	if(buffer_size > 0)
+		snprintf(buffer, buffer_size, "%.*s", n, buf);
+	return n;
+}
+
+
+sp_track *sp_link_as_track(sp_link *link){
+	if(link->kind != URI_TRACK)
+		return NULL;
+	return track_get(&link->id);
+}
+
+
+sp_album *sp_link_as_album(sp_link *link){
+	return NULL;
+}
+
+
+sp_artist *sp_link_as_artist(sp_link *link){
+	return NULL;
+}
+
+
+/* ------------------------------- FOR REPLAYS ------------------------------ */
+
+/**
+ * Leave login and the loading of the container to the fake_ functions,
+ * sp_session_process_events() does nothing then.
+ */
+void fake_hold_events(void){
+	held = 1;
+}
+
+
+const sp_session_callbacks *fake_session_callbacks(sp_session *s){
+	return s->cb;
+}
+
+
+/**
+ * Log in, without any callback.
+ */
+void fake_log_in(sp_session *s){
+	s->logged_in = 1;
+	s->login_pending = 0;
+}
+
+
+/**
+ * The track of a URI.
+ *
+ * @return NULL if it's no track URI.
+ */
+sp_track *fake_track(const char *uri){
+	struct uri u;
+	if(uri_parse(uri, &u) != URI_TRACK)
+		return NULL;
+	return track_get(&u.id);
+}
+
+
+/**
+ * The playlist of a URI, with the given name.
+ *
+ * @return NULL if it's no playlist URI.
+ */
+sp_playlist *fake_playlist(const char *uri, const char *name){
+	struct uri u;
+	char user[256];
+	if(uri_parse(uri, &u) != URI_PLAYLIST)
+		return NULL;
+	snprintf(user, sizeof(user), "%.*s", u.user_len, u.user);
+	sp_playlist *pl = playlist_get(&u.id, user);
+	if(name && strcmp(pl->name, name)){
+		free(pl->name);
+		pl->name = must(strdup(name));
+	}
+	return pl;
+}
+
+
+/**
+ * Make the container hold just the given playlists, without callbacks.
+ */
+void fake_set_container(sp_session *s, sp_playlist **v, int n){
+	int i;
+	while(s->pc.num)
+		container_delete(&s->pc, s->pc.num - 1);
+	for(i = 0; i < n; i++)
+		container_insert(&s->pc, v[i], i);
+}
+
+
+/**
+ * Make the playlist hold just the given tracks, without callbacks.
+ */
+void fake_set_tracks(sp_playlist *pl, sp_track **v, int n){
+	pl->num = 0;
+	tracks_insert(pl, v, n, 0);
+}
+
+
+void fake_container_loaded(sp_session *s){
+	int i;
+	s->pc.loaded = 1;
+	for(i = 0; i < s->pc.num_cbs; i++)
+		if(s->pc.cbs[i].cb->container_loaded)
+			s->pc.cbs[i].cb->container_loaded(&s->pc, s->pc.cbs[i].userdata);
+}
+
+
+/*
+ * What follows changes the stand-in as the callback says, as far as
+ * it can, and then gives the callback as it was logged.
+ */
+
+void fake_playlist_added(sp_session *s, sp_playlist *pl, int position){
+	if(!pl->in_container)
+		container_insert(&s->pc, pl, position < s->pc.num ? position : s->pc.num);
+	fire_playlist_added(&s->pc, pl, position);
+}
+
+
+void fake_playlist_removed(sp_session *s, sp_playlist *pl, int position){
+	int i;
+	for(i = 0; i < s->pc.num && s->pc.v[i] != pl; i++)
+		;
+	if(i < s->pc.num)
+		container_delete(&s->pc, i);
+	fire_playlist_removed(&s->pc, pl, position);
+}
+
+
+void fake_tracks_added(sp_playlist *pl, sp_track * const *add, int n, int position){
+	int i;
+	tracks_insert(pl, add, n, position < pl->num ? position : pl->num);
+	for(i = 0; i < pl->num_cbs; i++)
+		if(pl->cbs[i].cb->tracks_added)
+			pl->cbs[i].cb->tracks_added(pl, add, n, position, pl->cbs[i].userdata);
+}
+
+
+void fake_tracks_removed(sp_playlist *pl, const int *remove, int n){
+	int i;
+	tracks_delete(pl, remove, n);
+	for(i = 0; i < pl->num_cbs; i++)
+		if(pl->cbs[i].cb->tracks_removed)
+			pl->cbs[i].cb->tracks_removed(pl, remove, n, pl->cbs[i].userdata);
+}
+
+
+void fake_tracks_moved(sp_playlist *pl, const int *move, int n, int new_position){
+	int i, j, at = new_position;
+	sp_track **moving = must(malloc((n ? n : 1) * sizeof(*moving)));
+	for(i = j = 0; i < n; i++){
+		if(move[i] < 0 || move[i] >= pl->num)
+			continue;
+		moving[j++] = pl->tracks[move[i]];
+		if(move[i] < new_position)
+			at--;
+	}
+	tracks_delete(pl, move, n);
+	if(at < 0)
+		at = 0;
+	tracks_insert(pl, moving, j, at < pl->num ? at : pl->num);
+	free(moving);
+	for(i = 0; i < pl->num_cbs; i++)
+		if(pl->cbs[i].cb->tracks_moved)
+			pl->cbs[i].cb->tracks_moved(pl, move, n, new_position, pl->cbs[i].userdata);
+}
+
+
+void fake_playlist_renamed(sp_playlist *pl, const char *name){
+	int i;
+	free(pl->name);
+	pl->name = must(strdup(name));
+	for(i = 0; i < pl->num_cbs; i++)
+		if(pl->cbs[i].cb->playlist_renamed)
+			pl->cbs[i].cb->playlist_renamed(pl, pl->cbs[i].userdata);
+}
+
+
+void fake_playlist_state_changed(sp_playlist *pl, int loaded){
+	int i;
+	pl->loading = !loaded;
+	for(i = 0; i < pl->num_cbs; i++)
+		if(pl->cbs[i].cb->playlist_state_changed)
+			pl->cbs[i].cb->playlist_state_changed(pl, pl->cbs[i].userdata);
+}
+
+
+void fake_playlist_update_in_progress(sp_playlist *pl, int done){
+	int i;
+	for(i = 0; i < pl->num_cbs; i++)
+		if(pl->cbs[i].cb->playlist_update_in_progress)
+			pl->cbs[i].cb->playlist_update_in_progress(pl, done, pl->cbs[i].userdata);
+}
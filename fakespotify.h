@@ -0,0 +1,30 @@
+#ifndef FAKESPOTIFY_H__
+#define FAKESPOTIFY_H__
+
+#include <libspotify/api.h>
+
+/*
+ * Only in the libspotify stand-in of fakespotify.c, for replaying a
+ * callback log, see replay.c.
+ */
+
+void fake_hold_events(void);
+const sp_session_callbacks *fake_session_callbacks(sp_session *s);
+void fake_log_in(sp_session *s);
+
+sp_track *fake_track(const char *uri);
+sp_playlist *fake_playlist(const char *uri, const char *name);
+void fake_set_container(sp_session *s, sp_playlist **v, int n);
+void fake_set_tracks(sp_playlist *pl, sp_track **v, int n);
+
+void fake_container_loaded(sp_session *s);
+void fake_playlist_added(sp_session *s, sp_playlist *pl, int position);
+void fake_playlist_removed(sp_session *s, sp_playlist *pl, int position);
+void fake_tracks_added(sp_playlist *pl, sp_track * const *tracks, int n, int position);
+void fake_tracks_removed(sp_playlist *pl, const int *tracks, int n);
+void fake_tracks_moved(sp_playlist *pl, const int *tracks, int n, int new_position);
+void fake_playlist_renamed(sp_playlist *pl, const char *name);
+void fake_playlist_state_changed(sp_playlist *pl, int loaded);
+void fake_playlist_update_in_progress(sp_playlist *pl, int done);
+
+#endif
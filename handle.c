@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include "listify.h"
+#include "cmd.h"
+#include "handle.h"
+
+
+/*
+ * Counting of the references we hold, see handle.h. The counts are
+ * only touched from the main thread.
+ * 
+ * */
+
+static long live[NUM_HANDLE_TYPES];
+
+static const char *TYPE_LABELS[NUM_HANDLE_TYPES] = {
+	"links",
+	"playlists",
+	"tracks",
+};
+
+
+/**
+ * Own a link that was just created, by sp_link_create_from_*().
+ * 
+ * @return link, which may be NULL.
+ * */
+sp_link *handle_link(sp_link *link){
+	if(link)
+		live[HANDLE_LINK]++;
+	return link;
+}
+
+
+void handle_link_release(sp_link **link){
+	if(!*link)
+		return;
+	sp_link_release(*link);
+	live[HANDLE_LINK]--;
+	*link = NULL;
+}
+
+
+/**
+ * Own a playlist that was just created, by sp_playlist_create().
+ * 
+ * @return pl, which may be NULL.
+ * */
+sp_playlist *handle_playlist(sp_playlist *pl){
+	if(pl)
+		live[HANDLE_PLAYLIST]++;
+	return pl;
+}
+
+
+/**
+ * Take one more reference to a playlist.
+ * 
+ * @return pl.
+ * */
+sp_playlist *handle_playlist_ref(sp_playlist *pl){
+	sp_playlist_add_ref(pl);
+	live[HANDLE_PLAYLIST]++;
+	return pl;
+}
+
+
+void handle_playlist_release(sp_playlist **pl){
+	if(!*pl)
+		return;
+	sp_playlist_release(*pl);
+	live[HANDLE_PLAYLIST]--;
+	*pl = NULL;
+}
+
+
+/**
+ * Take one more reference to a track.
+ * 
+ * @return track.
+ * */
+sp_track *handle_track_ref(sp_track *track){
+	sp_track_add_ref(track);
+	live[HANDLE_TRACK]++;
+	return track;
+}
+
+
+void handle_track_release(sp_track **track){
+	if(!*track)
+		return;
+	sp_track_release(*track);
+	live[HANDLE_TRACK]--;
+	*track = NULL;
+}
+
+
+long handle_live(enum handle_type type){
+	return live[type];
+}
+
+
+/**
+ * Print how many references of each kind we hold. If a number keeps
+ * growing from one command to the next, something leaks.
+ * 
+ * @return -1.
+ * */
+int cmd_handles(int argc, char **argv){
+	int i;
+	for(i = 0; i < NUM_HANDLE_TYPES; i++)
+		printf("  %-20s %ld\n", TYPE_LABELS[i], live[i]);
+	return -1;
+}
@@ -0,0 +1,57 @@
+#ifndef HANDLE_H__
+#define HANDLE_H__
+
+#include <libspotify/api.h>
+
+/*
+ * Owned references to libspotify handles. Every reference we take goes
+ * through one of the functions below, so that it's counted, and is
+ * given back with the matching handle_*_release().
+ * 
+ * The release functions take the address of the variable, and set it
+ * to NULL, so that they can be used as cleanup functions: a variable
+ * declared with one of the SCOPED_ markers is released when it goes
+ * out of scope. To keep such a reference, take it with
+ * handle_*_take().
+ */
+
+enum handle_type {
+	HANDLE_LINK,
+	HANDLE_PLAYLIST,
+	HANDLE_TRACK,
+	NUM_HANDLE_TYPES,
+};
+
+sp_link *handle_link(sp_link *link);
+void handle_link_release(sp_link **link);
+
+sp_playlist *handle_playlist(sp_playlist *pl);
+sp_playlist *handle_playlist_ref(sp_playlist *pl);
+void handle_playlist_release(sp_playlist **pl);
+
+sp_track *handle_track_ref(sp_track *track);
+void handle_track_release(sp_track **track);
+
+long handle_live(enum handle_type type);
+
+static inline sp_link *handle_link_take(sp_link **link){
+	sp_link *l = *link;
+	*link = NULL;
+	return l;
+}
+
+static inline sp_playlist *handle_playlist_take(sp_playlist **pl){
+	sp_playlist *p = *pl;
+	*pl = NULL;
+	return p;
+}
+
+#if defined(__GNUC__)
+#define SCOPED_LINK     __attribute__((cleanup(handle_link_release)))
+#define SCOPED_PLAYLIST __attribute__((cleanup(handle_playlist_release)))
+#define SCOPED_TRACK    __attribute__((cleanup(handle_track_release)))
+#else
+#error "The SCOPED_ handles need a compiler with __attribute__((cleanup))"
+#endif
+
+#endif
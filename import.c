@@ -0,0 +1,585 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "listify.h"
+#include "cmd.h"
+#include "link.h"
+#include "list.h"
+#include "lines.h"
+#include "expand.h"
+#include "uri.h"
+#include "handle.h"
+#include "pool.h"
+#include "ptrmap.h"
+#include "members.h"
+#include "import.h"
+
+
+/*
+ * An import adds a list of items to a playlist, in the given order.
+ * Some items are known tracks, others have to be looked up first
+ * (searches) or expanded to many tracks (albums and artists, see
+ * expand.c). The lookups are issued IMPORT_WINDOW at a time, and as
+ * soon as the items at the front are done they are added to the
+ * playlist in chunks of ADD_CHUNK. So a long list costs a few round
+ * trips rather than one per item, and the playlist still gets the
+ * tracks in the order of the input.
+ * 
+ * A --unique import leaves out the tracks the playlist has already,
+ * see members.c, and those it has added itself, so none of them get
+ * to sp_playlist_add_tracks().
+ * 
+ * */
+
+enum item_kind {
+	ITEM_TRACK,
+	ITEM_SEARCH,
+	ITEM_ALBUM,
+	ITEM_ARTIST,
+};
+
+enum item_state {
+	ITEM_WAITING,
+	ITEM_IN_FLIGHT,
+	ITEM_DONE,
+};
+
+struct import_item {
+	struct import_job *job;
+	enum item_kind kind;
+	enum item_state state;
+	char *query;
+	sp_album *album;
+	sp_artist *artist;
+	sp_track *one;     // the track, or the top hit of the search
+	sp_track **tracks; // what to add, NULL if the lookup found nothing
+	int num_tracks;
+};
+
+struct import_job {
+	sp_playlist *pl;
+	int num_items;
+	int next_issue;    // first item not yet looked up
+	int next_flush;    // first item not yet added to the playlist
+	int in_flight;
+	int added;
+	int misses;
+	int failed;
+	int unique;        // leave out tracks the playlist has
+	int dupes;         // tracks left out for that
+	struct ptrmap seen; // what we have added, when unique
+	unsigned int token; // the command to finish when done, 0 if none
+	int issuing;       // set while in import_issue()
+	int batch_size;
+	sp_track *batch[ADD_CHUNK];
+	struct import_item items[];
+};
+
+
+static int import_issue(struct import_job *job);
+static int import_checked_links(sp_playlist *pl, int n, char **URIs, int unique);
+static void import_progress(struct import_job *job);
+
+
+/**
+ * Tell if the command of the job was given up on. Nothing more is
+ * looked up or added then, and the job is freed once the lookups it
+ * has in flight are back.
+ * */
+static int import_given_up(struct import_job *job){
+	return job->token && !cmd_waiting(job->token);
+}
+
+
+/**
+ * Create an import of num_items items into the playlist pl. Every item
+ * has to be set with one of the import_set_ functions before
+ * import_start() is called.
+ * 
+ * @return the job, NULL if out of memory.
+ * */
+struct import_job *import_new(sp_playlist *pl, int num_items){
+	struct import_job *job = calloc(1, sizeof(*job) + num_items * sizeof(struct import_item));
+	if(!job){
+		fprintf(stderr, "Out of memory, can't import %d items.\n", num_items);
+		return NULL;
+	}
+	job->pl = handle_playlist_ref(pl);
+	job->num_items = num_items;
+	int i;
+	for(i = 0; i < num_items; i++)
+		job->items[i].job = job;
+	return job;
+}
+
+
+/**
+ * Item i is the given track.
+ * */
+void import_set_track(struct import_job *job, int i, sp_track *track){
+	struct import_item *it = &job->items[i];
+	it->kind = ITEM_TRACK;
+	it->state = ITEM_DONE;
+	it->one = track;
+	it->tracks = &it->one;
+	it->num_tracks = 1;
+	handle_track_ref(track);
+}
+
+
+/**
+ * Item i is the top hit of a search for query.
+ * 
+ * @return -1 if out of memory. 0 otherwise.
+ * */
+int import_set_search(struct import_job *job, int i, const char *query){
+	struct import_item *it = &job->items[i];
+	it->kind = ITEM_SEARCH;
+	it->state = ITEM_WAITING;
+	it->query = strdup(query);
+	return it->query ? 0 : -1;
+}
+
+
+/**
+ * Item i is what link points to: a track, or all tracks of an album
+ * or an artist.
+ * 
+ * @return -1 if the link is of any other type. 0 otherwise.
+ * */
+int import_set_link(struct import_job *job, int i, sp_link *link){
+	struct import_item *it = &job->items[i];
+	sp_linktype lt = sp_link_type(link);
+	switch(lt){
+	case SP_LINKTYPE_TRACK:
+		it->one = sp_link_as_track(link);
+		if(!it->one)
+			break;
+		import_set_track(job, i, it->one);
+		return 0;
+	case SP_LINKTYPE_ALBUM:
+		it->album = sp_link_as_album(link);
+		if(!it->album)
+			break;
+		sp_album_add_ref(it->album);
+		it->kind = ITEM_ALBUM;
+		it->state = ITEM_WAITING;
+		return 0;
+	case SP_LINKTYPE_ARTIST:
+		it->artist = sp_link_as_artist(link);
+		if(!it->artist)
+			break;
+		sp_artist_add_ref(it->artist);
+		it->kind = ITEM_ARTIST;
+		it->state = ITEM_WAITING;
+		return 0;
+	default:
+		fprintf(stderr, "The URI was of type '%s', not a track, album or artist\n",
+		        get_link_type_label(lt));
+		return -1;
+	}
+	fprintf(stderr, "Failed to retrieve the %s from the link\n", get_link_type_label(lt));
+	return -1;
+}
+
+
+/**
+ * Leave out of the import the tracks the playlist has already, and
+ * those that come up twice.
+ * 
+ * @return -1 if the playlist isn't loaded yet, or out of memory.
+ * */
+int import_set_unique(struct import_job *job){
+	if(members_open(job->pl)){
+		fprintf(stderr, "Can't tell which tracks %s has, is it loaded?\n",
+		        sp_playlist_name(job->pl));
+		return -1;
+	}
+	ptrmap_init(&job->seen);
+	job->unique = 1;
+	return 0;
+}
+
+
+/**
+ * Free the job and what it holds. The expanded tracks belong to the
+ * expansion cache, so only the single tracks are released here.
+ * */
+static void import_free(struct import_job *job){
+	int i;
+	for(i = 0; i < job->num_items; i++){
+		struct import_item *it = &job->items[i];
+		handle_track_release(&it->one);
+		if(it->album)
+			sp_album_release(it->album);
+		if(it->artist)
+			sp_artist_release(it->artist);
+		free(it->query);
+	}
+	if(job->unique){
+		ptrmap_free(&job->seen);
+		members_close(job->pl);
+	}
+	handle_playlist_release(&job->pl);
+	free(job);
+}
+
+
+/**
+ * Start the import. The job is freed when it's done, which may be
+ * before this function returns.
+ * 
+ * @return -1 if the import is already done, and 0 if it will finish
+ *         the command with cmd_complete() when it is. Just as for a
+ *         command.
+ * */
+int import_start(struct import_job *job){
+	import_issue(job);
+	if(job->in_flight){
+		job->token = cmd_token();
+		import_progress(job);
+		return 0;
+	}
+	import_progress(job);
+	return -1;
+}
+
+
+static void search_complete(sp_search *search, void *userdata){
+	struct import_item *it = userdata;
+	struct import_job *job = it->job;
+
+	if(sp_search_error(search) == SP_ERROR_OK && sp_search_num_tracks(search) > 0){
+		it->one = handle_track_ref(sp_search_track(search, 0));
+		it->tracks = &it->one;
+		it->num_tracks = 1;
+	} else {
+		printf("No match for '%s'\n", it->query);
+		job->misses++;
+	}
+	sp_search_release(search);
+
+	it->state = ITEM_DONE;
+	job->in_flight--;
+	import_progress(job);
+}
+
+
+static void expand_complete(sp_track **tracks, int num_tracks, void *userdata){
+	struct import_item *it = userdata;
+	struct import_job *job = it->job;
+
+	if(num_tracks < 0){
+		job->misses++;
+	} else {
+		it->tracks = tracks;
+		it->num_tracks = num_tracks;
+	}
+	it->state = ITEM_DONE;
+	job->in_flight--;
+	if(!job->issuing)
+		import_progress(job);
+}
+
+
+/**
+ * Start lookups until the window is full.
+ * 
+ * @return how many items got done right away, from the expansion
+ *         cache or because the lookup couldn't be started.
+ * */
+static int import_issue(struct import_job *job){
+	int done = 0;
+	if(import_given_up(job))
+		return 0;
+	job->issuing = 1;
+	while(job->in_flight < IMPORT_WINDOW && job->next_issue < job->num_items){
+		struct import_item *it = &job->items[job->next_issue++];
+		int r = 0;
+		if(it->state != ITEM_WAITING)
+			continue;
+		it->state = ITEM_IN_FLIGHT;
+		job->in_flight++;
+		switch(it->kind){
+		case ITEM_SEARCH:
+			if(!sp_search_create(g_session, it->query, 0, 1, 0, 0, 0, 0,
+			                     &search_complete, it)){
+				fprintf(stderr, "Couldn't search for '%s'\n", it->query);
+				r = -1;
+			}
+			break;
+		case ITEM_ALBUM:
+			r = expand_album(it->album, &expand_complete, it);
+			break;
+		case ITEM_ARTIST:
+			r = expand_artist(it->artist, &expand_complete, it);
+			break;
+		default:
+			break;
+		}
+		if(r < 0){
+			it->state = ITEM_DONE;
+			job->in_flight--;
+			job->misses++;
+		}
+		if(r)
+			done++;
+	}
+	job->issuing = 0;
+	return done;
+}
+
+
+/**
+ * Tell if a unique import should leave a track out, else remember it.
+ * */
+static int import_dupe(struct import_job *job, sp_track *track){
+	if(members_has(job->pl, track) || ptrmap_get(&job->seen, track))
+		return 1;
+	ptrmap_put(&job->seen, track, track);
+	return 0;
+}
+
+
+static void import_add_batch(struct import_job *job){
+	if(import_given_up(job))
+		job->batch_size = 0;
+	if(!job->batch_size)
+		return;
+	sp_error err = add_tracks_chunked(job->pl, job->batch, job->batch_size, -1);
+	if(err != SP_ERROR_OK){
+		fprintf(stderr, "Error '%s' when trying to add %d tracks to the playlist.\n",
+		        sp_error_message(err), job->batch_size);
+		job->failed += job->batch_size;
+	} else {
+		job->added += job->batch_size;
+	}
+	job->batch_size = 0;
+}
+
+
+/**
+ * Add what is done at the front of the list, look up more, and
+ * finish the job if everything is done.
+ * */
+static void import_progress(struct import_job *job){
+	if(import_given_up(job)){
+		if(!job->in_flight){
+			fprintf(stderr, "Import given up on after adding %d tracks.\n", job->added);
+			import_free(job);
+		}
+		return;
+	}
+	do {
+		while(job->next_flush < job->num_items &&
+		      job->items[job->next_flush].state == ITEM_DONE){
+			struct import_item *it = &job->items[job->next_flush++];
+			int i;
+			for(i = 0; i < it->num_tracks; i++){
+				if(job->unique && import_dupe(job, it->tracks[i])){
+					job->dupes++;
+					continue;
+				}
+				job->batch[job->batch_size++] = it->tracks[i];
+				if(job->batch_size == ADD_CHUNK)
+					import_add_batch(job);
+			}
+		}
+	} while(import_issue(job));
+
+	if(job->next_flush < job->num_items)
+		return;
+
+	import_add_batch(job);
+	printf("Added %d tracks", job->added);
+	if(job->dupes)
+		printf(", %d were in the playlist already", job->dupes);
+	if(job->misses)
+		printf(", %d items had no match", job->misses);
+	if(job->failed)
+		printf(", %d tracks couldn't be added", job->failed);
+	printf(".\n");
+	fflush(stdout);
+
+	unsigned int token = job->token;
+	import_free(job);
+	if(token)
+		cmd_complete(token);
+}
+
+
+/**
+ * Import a list of URIs into a playlist. Nothing is added if any of
+ * the URIs is bad.
+ * 
+ * @param unique leave out the tracks the playlist has, see
+ *               import_set_unique().
+ * 
+ * @return -1 if done or failed, 0 if the import is running.
+ * */
+int import_links(sp_playlist *pl, int n, char **URIs, int unique){
+	// Check them all before libspotify sees any of them
+	int bad = uri_parse_bulk(URIs, n, NULL);
+	if(bad >= 0){
+		fprintf(stderr, "Nothing was added, %s isn't a Spotify URI\n", URIs[bad]);
+		return -1;
+	}
+	return import_checked_links(pl, n, URIs, unique);
+}
+
+
+/**
+ * import_links() for URIs that are known to be good.
+ * */
+static int import_checked_links(sp_playlist *pl, int n, char **URIs, int unique){
+	struct import_job *job = import_new(pl, n);
+	if(!job)
+		return -1;
+	if(unique && import_set_unique(job)){
+		import_free(job);
+		return -1;
+	}
+	int i;
+	for(i = 0; i < n; i++){
+		SCOPED_LINK sp_link *link = handle_link(sp_link_create_from_string(URIs[i]));
+		if(!link){
+			fprintf(stderr, "failed to get link from the Spotify URI %s\n", URIs[i]);
+			import_free(job);
+			return -1;
+		}
+		if(import_set_link(job, i, link)){
+			fprintf(stderr, "Nothing was added, because of %s\n", URIs[i]);
+			import_free(job);
+			return -1;
+		}
+	}
+	return import_start(job);
+}
+
+
+/**
+ * Search for each line of a file, and add the top hits to the end of
+ * a playlist, in the order of the file.
+ * 
+ * @param 1
+ * The full URI of the playlist.
+ * @param 2
+ * A file with one search query per line, like "artist - title".
+ * With --unique, tracks already in the playlist are left out.
+ * 
+ * @return -1 if done, 0 if the searches are running.
+ * */
+int cmd_add_search(int argc, char **argv){
+	sp_playlist *pl = cmd_arg_playlist(1);
+	struct lines lines;
+	if(lines_read(argv[2], &lines))
+		return -1;
+
+	struct import_job *job = import_new(pl, lines.num);
+	if(!job){
+		lines_free(&lines);
+		return -1;
+	}
+	if(cmd_option("--unique") && import_set_unique(job)){
+		lines_free(&lines);
+		import_free(job);
+		return -1;
+	}
+	int i;
+	for(i = 0; i < lines.num; i++){
+		if(import_set_search(job, i, lines.line[i])){
+			fprintf(stderr, "Out of memory.\n");
+			lines_free(&lines);
+			import_free(job);
+			return -1;
+		}
+	}
+	lines_free(&lines);
+
+	printf("Searching for %d queries, %d at a time.\n", job->num_items, IMPORT_WINDOW);
+	return import_start(job);
+}
+
+
+/*
+ * Reading and checking the file of add_file can take a while for a long
+ * one, so it is done on the thread pool, and only the import itself on
+ * the main thread.
+ * */
+struct file_job {
+	sp_playlist *pl;
+	struct lines lines;
+	int failed;
+	int bad;           // the first line that isn't a URI, or -1
+	int unique;
+	unsigned int token;
+	char path[];
+};
+
+
+/**
+ * Read and check the file, on a worker thread.
+ * */
+static void add_file_read(void *arg){
+	struct file_job *job = arg;
+	job->failed = lines_read(job->path, &job->lines);
+	if(!job->failed)
+		job->bad = uri_parse_bulk(job->lines.line, job->lines.num, NULL);
+}
+
+
+/**
+ * Import what was read, back on the main thread.
+ * */
+static void add_file_import(void *arg){
+	struct file_job *job = arg;
+	int r = -1;
+	if(!cmd_waiting(job->token)){
+		fprintf(stderr, "add_file: given up on, nothing was added from %s\n", job->path);
+	}else if(!job->failed){
+		if(job->bad >= 0)
+			fprintf(stderr, "Nothing was added, %s isn't a Spotify URI\n",
+			        job->lines.line[job->bad]);
+		else
+			r = import_checked_links(job->pl, job->lines.num, job->lines.line, job->unique);
+	}
+	unsigned int token = job->token;
+	handle_playlist_release(&job->pl);
+	if(!job->failed)
+		lines_free(&job->lines);
+	free(job);
+	if(r)
+		cmd_complete(token);
+}
+
+
+/**
+ * Add the tracks, albums and artists listed in a file to the end of a
+ * playlist, in the order of the file.
+ * 
+ * @param 1
+ * The full URI of the playlist.
+ * @param 2
+ * A file with one track, album or artist URI per line.
+ * With --unique, tracks already in the playlist are left out.
+ * 
+ * @return -1 if it failed, 0 if the file is being read.
+ * */
+int cmd_add_file(int argc, char **argv){
+	sp_playlist *pl = cmd_arg_playlist(1);
+	struct file_job *job = malloc(sizeof(struct file_job) + strlen(argv[2]) + 1);
+	if(!job){
+		fprintf(stderr, "Out of memory.\n");
+		return -1;
+	}
+	strcpy(job->path, argv[2]);
+	job->pl = handle_playlist_ref(pl);
+	job->unique = cmd_option("--unique");
+	job->token = cmd_token();
+	if(pool_submit(add_file_read, add_file_import, job)){
+		handle_playlist_release(&job->pl);
+		free(job);
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,19 @@
+#ifndef IMPORT_H__
+#define IMPORT_H__
+
+#include <libspotify/api.h>
+
+/* The most lookups (searches, browses) an import keeps in flight at once */
+#define IMPORT_WINDOW 64
+
+struct import_job;
+
+struct import_job *import_new(sp_playlist *pl, int num_items);
+void import_set_track(struct import_job *job, int i, sp_track *track);
+int import_set_search(struct import_job *job, int i, const char *query);
+int import_set_link(struct import_job *job, int i, sp_link *link);
+int import_set_unique(struct import_job *job);
+int import_start(struct import_job *job);
+int import_links(sp_playlist *pl, int n, char **URIs, int unique);
+
+#endif
@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lines.h"
+
+
+/*
+ * Reading of the files that some commands take as input. The whole
+ * file is read into one buffer, and the lines point into it.
+ * 
+ * */
+
+
+/**
+ * Read a file and split it in lines. Trailing whitespace is removed,
+ * and empty lines and lines starting with '#' are skipped.
+ * 
+ * @param path of the file.
+ * @param out will hold the lines, free it with lines_free().
+ * 
+ * @return -1 if fails. 0 if succeeds.
+ * */
+int lines_read(const char *path, struct lines *out){
+	FILE *f = fopen(path, "rb");
+	if(!f){
+		fprintf(stderr, "Couldn't open the file %s\n", path);
+		return -1;
+	}
+	size_t size = 0, cap = 4096, r;
+	char *buf = malloc(cap + 1);
+	while(buf && (r = fread(buf + size, 1, cap - size, f)) > 0){
+		size += r;
+		if(size == cap){
+			char *bigger = realloc(buf, cap * 2 + 1);
+			if(!bigger){
+				free(buf);
+				buf = NULL;
+				break;
+			}
+			buf = bigger;
+			cap *= 2;
+		}
+	}
+	fclose(f);
+	if(!buf){
+		fprintf(stderr, "Out of memory when reading %s\n", path);
+		return -1;
+	}
+	buf[size] = '\0';
+
+	int num = 0;
+	size_t i;
+	for(i = 0; i < size; i++)
+		if(buf[i] == '\n')
+			num++;
+	char **line = malloc((num + 1) * sizeof(char*));
+	if(!line){
+		fprintf(stderr, "Out of memory when reading %s\n", path);
+		free(buf);
+		return -1;
+	}
+
+	int n = 0;
+	char *cp = buf;
+	while(*cp){
+		char *end = strchr(cp, '\n');
+		char *next = end ? end + 1 : cp + strlen(cp);
+		if(!end)
+			end = next;
+		while(end > cp && (unsigned char)end[-1] <= ' ')
+			end--;
+		*end = '\0';
+		if(*cp && *cp != '#')
+			line[n++] = cp;
+		cp = next;
+	}
+
+	out->buf = buf;
+	out->line = line;
+	out->num = n;
+	return 0;
+}
+
+
+void lines_free(struct lines *l){
+	free(l->line);
+	free(l->buf);
+	l->line = NULL;
+	l->buf = NULL;
+	l->num = 0;
+}
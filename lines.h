@@ -0,0 +1,17 @@
+#ifndef LINES_H__
+#define LINES_H__
+
+/*
+ * A text file split up in lines, used by the commands that take
+ * their input from a file.
+ */
+struct lines {
+	char *buf;
+	char **line;
+	int num;
+};
+
+int lines_read(const char *path, struct lines *out);
+void lines_free(struct lines *l);
+
+#endif
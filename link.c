@@ -3,7 +3,11 @@
 #include "link.h"
 #include "list.h"
 #include "listify.h"
+#include "uri.h"
+#include "handle.h"
+#include "ptrmap.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 
@@ -44,10 +48,11 @@ const char* get_link_type_label(sp_linktype lt)
  * 
  * @param URI of the playlist.
  * 
- * @return the link for the playlist if succeded. NULL if fails.
+ * @return the link for the playlist if succeded, release it with
+ *         handle_link_release(). NULL if fails.
  */
 sp_link* URI_to_link(const char *URI){
-	sp_link *link = sp_link_create_from_string(URI);
+	SCOPED_LINK sp_link *link = handle_link(sp_link_create_from_string(URI));
 	if(!link) {
         fprintf(stderr, "failed to get link from a Spotify URI\n");
         return NULL;
@@ -58,7 +63,7 @@ sp_link* URI_to_link(const char *URI){
 		fprintf(stderr, "The URI was of type '%s', not as the exptected '%s'\n", link_type_label, get_link_type_label(SP_LINKTYPE_PLAYLIST));
 		return NULL;	
 	}
-	return link;
+	return handle_link_take(&link);
 }
 
 
@@ -71,11 +76,12 @@ sp_link* URI_to_link(const char *URI){
  * 
  * @param link to the playlist.
  * 
- * @return the playlist if succeded, NULL if failed.
+ * @return the playlist if succeded, release it with
+ *         handle_playlist_release(). NULL if failed.
  * */
 
 sp_playlist *sp_link_as_playlist(sp_link *link){
-	return sp_playlist_create(g_session, link);
+	return handle_playlist(sp_playlist_create(g_session, link));
 }
 
 
@@ -87,27 +93,115 @@ sp_playlist *sp_link_as_playlist(sp_link *link){
  * 
  * @param the URI of the playlist.
  * 
- * @return the playlist if succeded, NULL if failed.
+ * @return the playlist if succeded, release it with
+ *         handle_playlist_release(). NULL if failed.
  * 
  * */
 sp_playlist *URI_to_playlist(const char *URI){
-	sp_link *link = URI_to_link(URI);
+	SCOPED_LINK sp_link *link = URI_to_link(URI);
 	if(!link) {
 		fprintf(stderr, "URI --> link failed!\n");
 		return NULL;
 	}
-	return sp_link_as_playlist(link);
+	sp_playlist *pl = sp_link_as_playlist(link);
+	if(pl)
+		playlist_touch(pl); // we want its callbacks for a while
+	return pl;
 }
 
 
 /**
- * Given a playlists URI, remove it from the container
- * and giving it a +1 in reference so the spotify system
- * keeps it alive.
+ * Write the URI of a playlist.
  * 
- * I don't know what bad effects it has for "us" if we lose track
- * of the link and the playlist floats around without anyone pointing
- * to it.
+ * @return the length of the URI, 0 if it couldn't be had.
+ * */
+int playlist_to_URI(sp_playlist *pl, char *buff, int size){
+	SCOPED_LINK sp_link *link = handle_link(sp_link_create_from_playlist(pl));
+	if(size > 0)
+		buff[0] = '\0';
+	if(!link)
+		return 0;
+	int n = sp_link_as_string(link, buff, size);
+	return n < size ? n : 0;
+}
+
+
+/**
+ * Write the URI of a track.
+ * 
+ * @return the length of the URI, 0 if it couldn't be had.
+ * */
+int track_to_URI(sp_track *track, char *buff, int size){
+	SCOPED_LINK sp_link *link = handle_link(sp_link_create_from_track(track, 0));
+	if(size > 0)
+		buff[0] = '\0';
+	if(!link)
+		return 0;
+	int n = sp_link_as_string(link, buff, size);
+	return n < size ? n : 0;
+}
+
+
+/*
+ * The ids of the playlists in the container, so that looking for one
+ * in it compares 16 bytes an entry, rather than making and parsing the
+ * URI of each. An id is taken when the playlist is added or seen at
+ * login, or else the first time it is asked for, and the playlist is
+ * referenced until playlist_id_forget(), so its handle can't come back
+ * as another playlist.
+ * */
+
+/// sp_playlist* --> struct spid*
+static struct ptrmap playlist_ids;
+
+
+/**
+ * Get the id of a playlist of the container.
+ * 
+ * @return -1 if it couldn't be had, 0 otherwise.
+ * */
+int playlist_id(sp_playlist *pl, struct spid *id){
+	struct spid *known = pl ? ptrmap_get(&playlist_ids, pl) : NULL;
+	if(!pl)
+		return -1;
+	if(known){
+		*id = *known;
+		return 0;
+	}
+	char buff[256];
+	struct uri u;
+	if(playlist_to_URI(pl, buff, sizeof(buff)) <= 0 ||
+	   uri_parse(buff, &u) != URI_PLAYLIST)
+		return -1;
+	*id = u.id;
+	known = malloc(sizeof(*known));
+	if(!known)
+		return 0; // just not kept
+	*known = u.id;
+	if(ptrmap_put(&playlist_ids, pl, known)){
+		free(known);
+		return 0;
+	}
+	handle_playlist_ref(pl);
+	return 0;
+}
+
+
+/**
+ * The playlist left the container, drop its id.
+ * */
+void playlist_id_forget(sp_playlist *pl){
+	struct spid *known = ptrmap_remove(&playlist_ids, pl);
+	if(!known)
+		return;
+	free(known);
+	handle_playlist_release(&pl);
+}
+
+
+/**
+ * Given a playlists URI, remove it from the container. The playlist
+ * itself lives on at Spotify, so it can be added back by its URI.
  * 
  * @param the URI of the playlist.
  * 
@@ -115,25 +209,21 @@ sp_playlist *URI_to_playlist(const char *URI){
  * 
  * */  
 int hide_playlist(const char *URI){
-	sp_link *link = URI_to_link(URI);
-	if(!link){
-		fprintf(stderr, "URI --> link failed!\n");
-        return -1; // URI -> playlist failed
+	struct uri target;
+	if(uri_parse(URI, &target) != URI_PLAYLIST){
+		fprintf(stderr, "The URI %s isn't a playlist\n", URI);
+		return -1;
 	}
 	//So by now we know that the given argument is a correct URI
 	//of type playlist. So now let's now go through the elements of our
-	//container, the container will maybe contain a playlist who has 
-	//"the same sp_link", which means they are equal.
+	//container, the container will maybe contain a playlist with
+	//the same id, which means they are equal.
 	int i  =  0;
 	int n = sp_playlistcontainer_num_playlists(g_pc);
-	int lengthURI = strlen(URI);
 	while(i < n){
-		static char buff[100];
+		struct spid id;
 		sp_playlist * pl = sp_playlistcontainer_playlist(g_pc, i);
-		sp_link *link2 = sp_link_create_from_playlist(pl);
-		
-		if(sp_link_as_string(link2, buff, lengthURI+3) == lengthURI &&
-		   strcmp(URI, buff) == 0 ){
+		if(pl && !playlist_id(pl, &id) && spid_equal(&id, &target.id)){
 			//we found a match
 			break;
 		}
@@ -145,7 +235,6 @@ int hide_playlist(const char *URI){
 	}
 	
 	//now let's try to remove it
-	sp_link_add_ref(link); //ok, I doubt it will ever be released now ...
 	sp_error err = sp_playlistcontainer_remove_playlist(g_pc, i);
 	if(err != SP_ERROR_OK){
 		fprintf(stderr, "Error '%s' when trying to delete the playlist.\n", sp_error_message(err));
@@ -154,3 +243,26 @@ int hide_playlist(const char *URI){
 	return -1;
 }
 
+
+
+/**
+ * Print the type of each of the given URIs. This only needs the
+ * session, so it can be used while we are still logging in.
+ * 
+ * @param 1..n
+ * The URIs to look at.
+ * 
+ * @return -1.
+ * */
+int cmd_link_type(int argc, char **argv){
+	int i;
+	for(i = 1; i < argc; i++){
+		SCOPED_LINK sp_link *link = handle_link(sp_link_create_from_string(argv[i]));
+		if(!link){
+			printf("%s: not a Spotify URI\n", argv[i]);
+			continue;
+		}
+		printf("%s: %s\n", argv[i], get_link_type_label(sp_link_type(link)));
+	}
+	return -1;
+}
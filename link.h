@@ -3,11 +3,17 @@
 
 #include <libspotify/api.h>
 
+struct spid;
+
 const char* get_link_type_label(sp_linktype lt);
 sp_link* URI_to_link(const char *URI);
 sp_playlist *sp_link_as_playlist(sp_link *link);
 sp_playlist *URI_to_playlist(const char *URI);
 int hide_playlist(const char *URI);
+int playlist_to_URI(sp_playlist *pl, char *buff, int size);
+int track_to_URI(sp_track *track, char *buff, int size);
+int playlist_id(sp_playlist *pl, struct spid *id);
+void playlist_id_forget(sp_playlist *pl);
 
 #endif
 
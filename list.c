@@ -4,10 +4,42 @@
 #include "cmd.h"
 #include "link.h"
 #include "list.h"
+#include "import.h"
+#include "ptrmap.h"
+#include "stats.h"
+#include "trackindex.h"
+#include "members.h"
+#include "watch.h"
+#include "handle.h"
+#include "targets.h"
+#include "nameindex.h"
+#include "cblog.h"
+#include "arena.h"
+#include "pending.h"
+#include "uri.h"
 
 /* --- Data --- */
 sp_playlistcontainer *g_pc;
 
+/// How long a playlist no one has asked about keeps its callbacks
+#define SUBSCRIPTION_IDLE_MS 60000
+
+/*
+ * A playlist we have added our callbacks to. Pinned playlists keep
+ * them until unpinned, the others until they have been idle for
+ * SUBSCRIPTION_IDLE_MS.
+ */
+struct subscription {
+	int pins;
+	uint64_t last_used;
+};
+
+/// sp_playlist* --> struct subscription*
+static struct ptrmap subscriptions;
+
+/// When playlist_expire_idle() next has something to do, 0 if never
+static uint64_t next_expiry;
+
 
 
 /* --------------------------  PLAYLIST CALLBACKS  ------------------------- */
@@ -23,9 +55,12 @@ sp_playlistcontainer *g_pc;
 static void tracks_added(sp_playlist *pl, sp_track * const *tracks,
                          int num_tracks, int position, void *userdata)
 {
+	cblog_tracks_added(pl, tracks, num_tracks, position);
+	trackindex_tracks_added(pl, tracks, num_tracks, position);
+	members_tracks_added(pl, tracks, num_tracks, position);
+	watch_tracks_added(pl, tracks, num_tracks, position);
 	printf("listify: %d tracks were added\n", num_tracks);
 	fflush(stdout);
-	cmd_done();
 }
 
 /**
@@ -39,9 +74,12 @@ static void tracks_added(sp_playlist *pl, sp_track * const *tracks,
 static void tracks_removed(sp_playlist *pl, const int *tracks,
                            int num_tracks, void *userdata)
 {
+	cblog_tracks_removed(pl, tracks, num_tracks);
+	trackindex_tracks_removed(pl, tracks, num_tracks);
+	members_tracks_removed(pl, tracks, num_tracks);
+	watch_tracks_removed(pl, tracks, num_tracks);
 	printf("jukebox: %d tracks were removed\n", num_tracks);
 	fflush(stdout);
-	cmd_done();
 }
 
 /**
@@ -56,10 +94,13 @@ static void tracks_removed(sp_playlist *pl, const int *tracks,
 static void tracks_moved(sp_playlist *pl, const int *tracks,
                          int num_tracks, int new_position, void *userdata)
 {
+	cblog_tracks_moved(pl, tracks, num_tracks, new_position);
 	const char *name = sp_playlist_name(pl);
+	trackindex_tracks_moved(pl);
+	members_tracks_moved(pl);
+	watch_tracks_moved(pl, tracks, num_tracks, new_position);
 	printf("jukebox: %d tracks were moved around, in playlist %s\n", num_tracks, name);
 	fflush(stdout);
-	cmd_done();
 }
 
 /**
@@ -70,11 +111,45 @@ static void tracks_moved(sp_playlist *pl, const int *tracks,
  */
 static void playlist_renamed(sp_playlist *pl, void *userdata)
 {
+	cblog_playlist_renamed(pl);
 	const char *name = sp_playlist_name(pl);
+	nameindex_playlist_renamed(pl);
+	watch_playlist_renamed(pl);
 	printf("jukebox: some playlist renamed to \"%s\".\n", name);
 	fflush(stdout);
-	cmd_done();
-	
+}
+
+/**
+ * Callback from libspotify. The playlist got loaded, or its state
+ * changed in some other way.
+ *
+ * @param  pl            The playlist handle
+ * @param  userdata      The opaque pointer
+ */
+static void playlist_state_changed(sp_playlist *pl, void *userdata)
+{
+	cblog_playlist_state_changed(pl);
+	if(sp_playlist_is_loaded(pl)){
+		trackindex_playlist_loaded(pl);
+		members_playlist_loaded(pl);
+		nameindex_playlist_renamed(pl);
+	}
+	pending_check(pl); // it may have synced our changes
+}
+
+/**
+ * Callback from libspotify. A series of changes to the playlist is
+ * about to be applied, or has been.
+ *
+ * @param  pl            The playlist handle
+ * @param  done          True when they have been
+ * @param  userdata      The opaque pointer
+ */
+static void playlist_update_in_progress(sp_playlist *pl, bool done, void *userdata)
+{
+	cblog_playlist_update_in_progress(pl, done);
+	if(done)
+		pending_check(pl);
 }
 
 /**
@@ -85,6 +160,8 @@ static sp_playlist_callbacks pl_callbacks = {
 	.tracks_removed = &tracks_removed,
 	.tracks_moved = &tracks_moved,
 	.playlist_renamed = &playlist_renamed,
+	.playlist_state_changed = &playlist_state_changed,
+	.playlist_update_in_progress = &playlist_update_in_progress,
 };
 
 
@@ -92,7 +169,8 @@ static sp_playlist_callbacks pl_callbacks = {
 /**
  * Callback from libspotify, telling us a playlist was added to the playlist container.
  *
- * We add our playlist callbacks to the newly added playlist.
+ * Our playlist callbacks are added later, when a command uses the
+ * playlist, see playlist_touch().
  *
  * @param  pc            The playlist container handle
  * @param  pl            The playlist handle
@@ -102,11 +180,15 @@ static sp_playlist_callbacks pl_callbacks = {
 static void playlist_added(sp_playlistcontainer *pc, sp_playlist *pl,
                            int position, void *userdata)
 {
+	struct spid id;
+	cblog_playlist_added(pc, pl, position);
 	const char *name = sp_playlist_name(pl);	
 	printf("playlist with name %s was added\n", name);
 	fflush(stdout);
-	sp_playlist_add_callbacks(pl, &pl_callbacks, NULL);
-	cmd_done();
+	trackindex_playlist_added(pl);
+	nameindex_playlist_added(pl);
+	watch_playlist_added(pl, position);
+	playlist_id(pl, &id);
 }
 
 /**
@@ -122,12 +204,15 @@ static void playlist_added(sp_playlistcontainer *pc, sp_playlist *pl,
 static void playlist_removed(sp_playlistcontainer *pc, sp_playlist *pl,
                              int position, void *userdata)
 {
+	cblog_playlist_removed(pc, pl, position);
 	
 	printf("playlist_removed() was called\n");
 	fflush(stdout);
-	cmd_done();
-	/*sp_playlist_remove_callbacks(pl, &pl_callbacks, NULL);
-	 * */
+	trackindex_playlist_removed(pl);
+	nameindex_playlist_removed(pl);
+	watch_playlist_removed(pl, position);
+	playlist_unsubscribe(pl);
+	playlist_id_forget(pl);
 }
 
 
@@ -140,10 +225,19 @@ static void playlist_removed(sp_playlistcontainer *pc, sp_playlist *pl,
  */
 static void container_loaded(sp_playlistcontainer *pc, void *userdata)
 {
+	cblog_container_loaded(pc);
 	g_pc = pc;
 	printf("container_loaded() was called\n");
+	// The names are all in now, some may not have been before
+	struct spid id;
+	int i;
+	for(i = 0; i < sp_playlistcontainer_num_playlists(pc); i++){
+		sp_playlist *pl = sp_playlistcontainer_playlist(pc, i);
+		nameindex_playlist_added(pl);
+		playlist_id(pl, &id);
+	}
 	fflush(stdout);
-	cmd_done();
+	cmd_container_ready();
 	/*
 	fprintf(stderr, "jukebox: Rootlist synchronized\n");
 	* */
@@ -162,6 +256,117 @@ sp_playlistcontainer_callbacks pc_callbacks = {
 
 /* -------------------------  END  PLAYLIST CONTAINER CALLBACKS ------------ */
 
+/* ---------------------------  SUBSCRIPTIONS  ----------------------------- */
+
+/*
+ * With thousands of playlists in the container, having our callbacks
+ * on all of them means every change anywhere wakes us up. So the
+ * callbacks are only added to the playlists that are in use.
+ * 
+ * */
+
+
+static struct subscription *playlist_subscribe(sp_playlist *pl){
+	struct subscription *sub = ptrmap_get(&subscriptions, pl);
+	if(sub)
+		return sub;
+	sub = calloc(1, sizeof(*sub));
+	if(!sub || ptrmap_put(&subscriptions, pl, sub)){
+		fprintf(stderr, "Out of memory, can't follow the playlist.\n");
+		free(sub);
+		return NULL;
+	}
+	handle_playlist_ref(pl);
+	sp_playlist_add_callbacks(pl, &pl_callbacks, NULL);
+	return sub;
+}
+
+
+/**
+ * Tell that a playlist is used, so that we get its callbacks for
+ * at least SUBSCRIPTION_IDLE_MS more.
+ * */
+void playlist_touch(sp_playlist *pl){
+	struct subscription *sub = playlist_subscribe(pl);
+	if(!sub)
+		return;
+	sub->last_used = stats_now_usec();
+	if(!next_expiry)
+		next_expiry = sub->last_used + SUBSCRIPTION_IDLE_MS * 1000ULL;
+}
+
+
+/**
+ * Keep the callbacks of a playlist until playlist_unpin().
+ * */
+void playlist_pin(sp_playlist *pl){
+	struct subscription *sub = playlist_subscribe(pl);
+	if(sub)
+		sub->pins++;
+}
+
+
+void playlist_unpin(sp_playlist *pl){
+	struct subscription *sub = ptrmap_get(&subscriptions, pl);
+	if(sub && sub->pins > 0 && --sub->pins == 0)
+		playlist_touch(pl);
+}
+
+
+/**
+ * Remove our callbacks from a playlist, pinned or not.
+ * */
+void playlist_unsubscribe(sp_playlist *pl){
+	struct subscription *sub = ptrmap_remove(&subscriptions, pl);
+	if(!sub)
+		return;
+	sp_playlist_remove_callbacks(pl, &pl_callbacks, NULL);
+	members_forget(pl); // no one keeps it current now
+	pending_forget(pl);
+	handle_playlist_release(&pl);
+	free(sub);
+}
+
+
+/**
+ * Unsubscribe from the playlists that have been idle for too long.
+ * Called from the main loop.
+ * 
+ * @return ms until it should be called again, -1 if there is nothing
+ *         to wait for.
+ * */
+int playlist_expire_idle(void){
+	if(!next_expiry)
+		return -1;
+	uint64_t now = stats_now_usec();
+	if(now < next_expiry)
+		return (next_expiry - now) / 1000 + 1;
+
+	uint64_t idle = SUBSCRIPTION_IDLE_MS * 1000ULL;
+	sp_playlist *expired[64];
+	int n = 0;
+	unsigned int iter = 0;
+	void *key, *val;
+	next_expiry = 0;
+	while(ptrmap_next(&subscriptions, &iter, &key, &val)){
+		struct subscription *sub = val;
+		if(sub->pins)
+			continue;
+		if(sub->last_used + idle <= now && n < 64){
+			expired[n++] = key;
+		} else if(!next_expiry || sub->last_used + idle < next_expiry){
+			next_expiry = sub->last_used + idle;
+		}
+	}
+	// Those that didn't fit this time are taken on the next call
+	if(n == 64)
+		next_expiry = now;
+	while(n > 0)
+		playlist_unsubscribe(expired[--n]);
+	return next_expiry ? (int)((next_expiry - now) / 1000 + 1) : -1;
+}
+
+
 /* ---------------------------  SESSION CALLBACKS  ------------------------- */
 
 /*static const char* get_link_type_label(sp_link *link)
@@ -191,20 +396,21 @@ sp_playlistcontainer_callbacks pc_callbacks = {
   
 void logged_in_playlist(sp_session* session){
 	sp_playlistcontainer *pc = sp_session_playlistcontainer(g_session);
+	struct spid id;
 	int i;
 
 	printf("jukebox: Looking at %d playlists\n", sp_playlistcontainer_num_playlists(pc));
 
+	// The callbacks are added as the playlists get used,
+	// see playlist_touch().
 	for (i = 0; i < sp_playlistcontainer_num_playlists(pc); ++i) {
 		sp_playlist *pl = sp_playlistcontainer_playlist(pc, i);
-		
-		sp_playlist_add_callbacks(pl, &pl_callbacks, NULL);
 
 		printf("Following playlist was added: %s\n", sp_playlist_name(pl));
+		nameindex_playlist_added(pl);
+		playlist_id(pl, &id);
 
 	}
-
-	cmd_done();
 }
 
 /* -------------------------  END SESSION CALLBACKS  ----------------------- */
@@ -228,35 +434,27 @@ void logged_in_playlist(sp_session* session){
  * 
  */
 int cmd_new_playlist(int argc, char **argv){	
-	if(argc != 2){		
-		fprintf(stderr, "Usage: %s <name>\n", argv[0]);
-		return -1;
-	}
 	char *URI = new_playlist(argv[1]);
 	if(!URI){
-		fprintf(stderr, "Failed in creating a new playlist");
+		fprintf(stderr, "Failed in creating a new playlist\n");
+		return -1;
 	}
 	
 	printf("The new playlist has the URI\n%s\n", URI);
-	free(URI);
 	return -1;
 }
 
 
 
 int cmd_new_hide(int argc, char **argv){
-	if(argc != 2){		
-		fprintf(stderr, "Usage: %s <name>\n", argv[0]);
-		return -1;
-	}
 	char *URI = new_playlist(argv[1]);
 	if(!URI){
-		fprintf(stderr, "Failed in creating a new playlist");
+		fprintf(stderr, "Failed in creating a new playlist\n");
+		return -1;
 	}
 	
 	printf("The new playlist has the URI\n%s\n", URI);
 	hide_playlist(URI); // In this verison we also hide the playlist
-	free(URI);
 	return -1;
 	
 }
@@ -270,11 +468,7 @@ int cmd_new_hide(int argc, char **argv){
  * 
  */
 int cmd_add_playlist(int argc, char **argv){	
-	if(argc != 2){
-		fprintf(stderr, "Usage: %s <URI>\n", argv[0]);
-		return -1;
-	}	
-	sp_link *link = URI_to_link(argv[1]);
+	SCOPED_LINK sp_link *link = URI_to_link(argv[1]);
 	if(!link){
 		fprintf(stderr, "URI couldn't be translated, can't add it to the playlist.\n");
 		return -1;		
@@ -289,44 +483,32 @@ int cmd_add_playlist(int argc, char **argv){
 
 
 /**
- * Clear a playlist
+ * Clear playlists
  * 
- * @param 1
- * The first token should be the full URI of the playlist, like:
+ * @param 1..n
+ * The playlists, see targets.c. Full URIs like:
  * spotify:user:JohnSmith:playlist:68sMl8CBblj6uBcqbJsnoj
+ * or file:<path> or glob:<pattern>.
  * 
  * @return -1.
  */
 int cmd_clear_playlist(int argc, char **argv){
-	if(argc != 2){
-		fprintf(stderr, "Usage: %s <URI>\n", argv[0]);
+	struct targets t;
+	int i;
+	if(targets_resolve(argc - 1, argv + 1, &t))
 		return -1;
-	}	
-	sp_playlist *pl = URI_to_playlist(argv[1]);
-	if(!pl){		
-		fprintf(stderr, "The given URI couldn't be converted to a playlist\n");
-        return -1; // URI -> playlist failed	
-	}
-	int n = sp_playlist_num_tracks(pl);
-	if(n > 0){
-		// for some reason it seems like something crashes when n = 0
-		int array[n];
-		int i;
-		for(i = 0; i < n; i++){
-			array[i] = i;
-		}
-		sp_error err = sp_playlist_remove_tracks(pl, array, n); // remove all tracks in it.
-		if(err != SP_ERROR_OK){
-			fprintf(stderr, "Error '%s' when trying to delete tracks of the playlist.\n", sp_error_message(err));
-			return -1;
-		}
-	}
+	for(i = 0; i < t.num; i++)
+		clear_tracks(t.v[i].pl);
+	if(t.num != 1)
+		printf("Cleared %d playlists.\n", t.num);
+	targets_free(&t);
 	return -1;	
 }
 
 
 /**
- * Add tracks to the end of a given playlist.
+ * Add tracks to the end of a given playlist. Albums and artists
+ * are expanded to all of their tracks, see import.c.
  * 
  * @param 1
  * The first token should be the full URI of the playlist, like:
@@ -334,90 +516,83 @@ int cmd_clear_playlist(int argc, char **argv){
  * @param 2
  * The second token should be the full URI of the track, like:
  * spotify:track:3GhpgjhCNZZa6Lb7Wtrp3S
+ * or of an album or an artist.
+ * With --unique, tracks already in the playlist are left out.
  * 
- * @return -1.
+ * @return -1 if done, 0 if albums or artists are being browsed.
  */
 int cmd_add_tracks(int argc, char **argv){
-	if(argc < 3){
-		fprintf(stderr, "Usage: %s <URI-playlist> <URI-track 1> <URI-track 2> ...\n", argv[0]);
-		return -1;
-	}
-	// let's retrieve the playlist	
-	sp_playlist *pl = URI_to_playlist(argv[1]);
-	if(!pl){		
-		fprintf(stderr, "The given URI couldn't be converted to a playlist\n");
-        return -1; // URI -> playlist failed	
-	}
-	
-	// let's retrieve the tracks
-	int n = argc-2;
-	sp_track *tracks[n];
-	int i;
-	for(i = 0; i < n; i++){		
-		const char * track_URI = argv[2+i];
-		sp_link *track_link = sp_link_create_from_string(track_URI);
-		if(!track_link) {
-			fprintf(stderr, "failed to get link from a Spotify URI\n");
-			return -1;
-		}
-		sp_linktype lt = sp_link_type(track_link);
-		if(lt != SP_LINKTYPE_TRACK){
-			const char * link_type_label = get_link_type_label(lt);		
-			fprintf(stderr, "The URI was of type '%s', not as the exptected '%s'\n", link_type_label, get_link_type_label(SP_LINKTYPE_TRACK));
-			return -1;
-		}
+	return import_links(cmd_arg_playlist(1), argc - 2, argv + 2, cmd_option("--unique"));
+}
 
-		sp_track *track = sp_link_as_track(track_link);
-		
-		if(!track){		
-			fprintf(stderr, "Failed to retrieve the track from the link %s\n", track_URI);
-			return -1;
-		}
-		tracks[i] = track;
-	}
-	//Now we hopefully got non-corrupt pointers to both the
-	//playlist and the tracks.
-	
-	int end = sp_playlist_num_tracks(pl);
-	sp_error err = sp_playlist_add_tracks(pl, (const sp_track**)tracks, n, end, g_session);
-	if(err != SP_ERROR_OK){
-		fprintf(stderr, "Error '%s' when trying to insert one track to the playlist.\n", sp_error_message(err));
+
+/**
+ * Append the tracks of one playlist to the end of another.
+ * 
+ * @param 1
+ * The full URI of the playlist to take the tracks from.
+ * @param 2
+ * The full URI of the playlist to add them to.
+ * 
+ * @return -1.
+ */
+int cmd_append_playlist(int argc, char **argv){
+	sp_playlist *src = cmd_arg_playlist(1);
+	sp_playlist *dst = cmd_arg_playlist(2);
+	append_tracks(src, dst);
+	return -1;
+}
+
+
+/**
+ * Make one playlist a copy of another, by clearing it and then
+ * appending the tracks of the other.
+ * 
+ * @param 1
+ * The full URI of the playlist to copy.
+ * @param 2
+ * The full URI of the playlist to overwrite.
+ * 
+ * @return -1.
+ */
+int cmd_copy_playlist(int argc, char **argv){
+	sp_playlist *src = cmd_arg_playlist(1);
+	sp_playlist *dst = cmd_arg_playlist(2);
+	if(src == dst)
+		return -1; // it is a copy of itself already
+	if(!sp_playlist_is_loaded(src)){
+		fprintf(stderr, "The playlist to copy isn't loaded yet, try again.\n");
 		return -1;
 	}
+	if(clear_tracks(dst) == SP_ERROR_OK)
+		append_tracks(src, dst);
 	return -1;
-	
-	// For some reason, for version 0.0.4, as I've understood it they
-	// want sp_playlist_add_tracks take the session as an additional
-	// last arguement. Which at least compiles for me.
 }
 
 
 /**
- * Count the amount of tracks in a playlist.
+ * Count the amount of tracks in playlists.
  * I mainly created this to see how "safe" the counting function is.
  * 
- * @param the URI
+ * @param 1..n
+ * The playlists, see targets.c.
  * 
  * @return -1.
  * */
 int cmd_count_tracks(int argc, char **argv){
-	printf("Hi!\n");
-	if(argc != 2){
-		fprintf(stderr, "Usage: %s <URI>\n", argv[0]);
+	struct targets t;
+	int i, total = 0;
+	if(targets_resolve(argc - 1, argv + 1, &t))
 		return -1;
-	}	
-	printf("Hi!\n");
-	sp_playlist *pl = URI_to_playlist(argv[1]);
-	printf("Hi!\n");
-	if(!pl){		
-		fprintf(stderr, "The given URI couldn't be converted to a playlist\n");
-        return -1; // URI -> playlist failed	
+	for(i = 0; i < t.num; i++){
+		int n = sp_playlist_num_tracks(t.v[i].pl);
+		if(t.num > 1)
+			printf("%8i  %s\n", n, sp_playlist_name(t.v[i].pl));
+		total += n;
 	}
-	printf("Hi!\n");
-	int n = sp_playlist_num_tracks(pl);
-	printf("Hi!\n");
+	targets_free(&t);
 	
-	printf("%i tracks.\n", n);
+	printf("%i tracks.\n", total);
 	return -1;
 }
 
@@ -425,25 +600,44 @@ int cmd_count_tracks(int argc, char **argv){
 
 
 /**
- * Remove a playlist from our container. Where 'our container' refers
+ * Remove playlists from our container. Where 'our container' refers
  * to the container that is g_pc, which should be the users container
  * if the user has successfuly logged in.
  * 
  * Indeed letting the playlist exist yet be removed from our container
  * gives the illusion of "hiding" the playlist.
  * 
- * @param 1
- * The first token should be the full URI of the playlist, like:
+ * They are removed from the last to the first, so that the index of
+ * those still to go doesn't change.
+ * 
+ * @param 1..n
+ * The playlists, see targets.c. Full URIs like:
  * spotify:user:JohnSmith:playlist:68sMl8CBblj6uBcqbJsnoj
+ * or file:<path> or glob:<pattern>.
  * 
  * @return -1.
  */
 int cmd_hide_playlist(int argc, char **argv){
-	if(argc != 2){
-		fprintf(stderr, "Usage: %s <URI>\n", argv[0]);
+	struct targets t;
+	int i, hidden = 0;
+	if(targets_resolve(argc - 1, argv + 1, &t))
 		return -1;
-	}	
-	return hide_playlist(argv[1]);
+	// The targets in the container come first, in the order of it
+	for(i = t.num - 1; i >= 0; i--){
+		if(t.v[i].index < 0){
+			printf("%s isn't in the container.\n", sp_playlist_name(t.v[i].pl));
+			continue;
+		}
+		sp_error err = sp_playlistcontainer_remove_playlist(g_pc, t.v[i].index);
+		if(err != SP_ERROR_OK){
+			fprintf(stderr, "Error '%s' when trying to delete the playlist.\n", sp_error_message(err));
+			continue;
+		}
+		hidden++;
+	}
+	printf("Hid %d playlists.\n", hidden);
+	targets_free(&t);
+	return -1;
 }
 
 /* ---------------------- END  IMPLEMENTED COMMANDS  ------------------------ */
@@ -465,13 +659,15 @@ int cmd_hide_playlist(int argc, char **argv){
  *        WARNING: name will be modified by the function.
  *                 (It will convert dashes to spaces)
  * 
- * @return The URI of the created playlist. NULL if failed.
+ * @return The URI of the created playlist, in the arena of the
+ *         command. NULL if failed.
  * */
 char * new_playlist(char* name){	
 	static const int buffSize = 200;
-	char * buff = (char*) malloc (buffSize);
+	char * buff = arena_alloc(buffSize);
 	if (buff==NULL){
-		fprintf(stderr, "Out of memory. Couldn't use malloc.\n"); 
+		fprintf(stderr, "Out of memory.\n"); 
+		return NULL;
 	}
 	
 	char* cp = name;
@@ -485,13 +681,102 @@ char * new_playlist(char* name){
 		fprintf(stderr, "new_playlist: creating playlist with name %s failed\n", name);
 		return NULL;		
 	}
-	// Get the sp_link-handle for the playlist
-	sp_link *spl = sp_link_create_from_playlist(pl);
-	
-	// Get the URI of the link.
-	sp_link_as_string(spl, buff, buffSize);
+	// Get the URI of the playlist, the container owns the playlist
+	// itself so there is nothing to release.
+	if(!playlist_to_URI(pl, buff, buffSize)){
+		fprintf(stderr, "new_playlist: no URI for the playlist %s\n", name);
+		return NULL;
+	}
 	return buff;
 } 
 
 
+/**
+ * Add tracks to a playlist, ADD_CHUNK of them at a time, so that
+ * neither libspotify nor the server gets one enormous change.
+ * 
+ * @param pl the playlist.
+ * @param tracks the tracks, in the order they should appear.
+ * @param n the number of tracks.
+ * @param position where to put the first track, -1 for the end.
+ * 
+ * @return SP_ERROR_OK, or the error of the first chunk that failed.
+ * */
+sp_error add_tracks_chunked(sp_playlist *pl, sp_track **tracks, int n, int position){
+	int done = 0;
+	if(position < 0)
+		position = sp_playlist_num_tracks(pl);
+	while(done < n){
+		int chunk = n - done < ADD_CHUNK ? n - done : ADD_CHUNK;
+		sp_error err = sp_playlist_add_tracks(pl, (const sp_track**)tracks + done,
+		                                      chunk, position + done, g_session);
+		if(err != SP_ERROR_OK)
+			return err;
+		pending_changed(pl, chunk);
+		done += chunk;
+	}
+	return SP_ERROR_OK;
+}
+
+
+/**
+ * Remove all tracks of a playlist.
+ * 
+ * @return SP_ERROR_OK, or what libspotify said.
+ * */
+sp_error clear_tracks(sp_playlist *pl){
+	int n = sp_playlist_num_tracks(pl);
+	if(n > 0){
+		// for some reason it seems like something crashes when n = 0
+		int *array = arena_alloc(n * sizeof(int));
+		int i;
+		if(!array){
+			fprintf(stderr, "Out of memory.\n");
+			return SP_ERROR_OTHER_PERMANENT;
+		}
+		for(i = 0; i < n; i++){
+			array[i] = i;
+		}
+		sp_error err = sp_playlist_remove_tracks(pl, array, n); // remove all tracks in it.
+		if(err != SP_ERROR_OK){
+			fprintf(stderr, "Error '%s' when trying to delete tracks of the playlist.\n", sp_error_message(err));
+			return err;
+		}
+		pending_changed(pl, n);
+	}
+	return SP_ERROR_OK;
+}
+
+
+/**
+ * Append all tracks of src to dst. The track handles go straight
+ * from one to the other, ADD_CHUNK at a time, so whatever the size
+ * of src only one chunk of handles is held here.
+ * 
+ * src and dst may be the same playlist, then it's doubled.
+ * 
+ * @return the number of tracks added.
+ * */
+int append_tracks(sp_playlist *src, sp_playlist *dst){
+	if(!sp_playlist_is_loaded(src)){
+		fprintf(stderr, "The playlist to take tracks from isn't loaded yet, try again.\n");
+		return 0;
+	}
+	sp_track *batch[ADD_CHUNK];
+	int n = sp_playlist_num_tracks(src); // before dst grows, if it's src
+	int i, j;
+	for(i = 0; i < n; i += j){
+		for(j = 0; j < ADD_CHUNK && i + j < n; j++)
+			batch[j] = sp_playlist_track(src, i + j);
+		sp_error err = add_tracks_chunked(dst, batch, j, -1);
+		if(err != SP_ERROR_OK){
+			fprintf(stderr, "Error '%s' when trying to add tracks to the playlist.\n", sp_error_message(err));
+			break;
+		}
+	}
+	printf("%d of %d tracks were appended.\n", i, n);
+	return i;
+}
+
+
 /* ---------------------- END HELP FUNCTIONS -------------------------------- */
@@ -1,7 +1,20 @@
 #ifndef LIST_H__
 #define LIST_H__
 
+#include <libspotify/api.h>
+
+/* The most tracks we give sp_playlist_add_tracks() in one call */
+#define ADD_CHUNK 100
+
 extern sp_playlistcontainer *g_pc;
 char * new_playlist(char* name);
+void playlist_touch(sp_playlist *pl);
+void playlist_pin(sp_playlist *pl);
+void playlist_unpin(sp_playlist *pl);
+void playlist_unsubscribe(sp_playlist *pl);
+int playlist_expire_idle(void);
+sp_error add_tracks_chunked(sp_playlist *pl, sp_track **tracks, int n, int position);
+sp_error clear_tracks(sp_playlist *pl);
+int append_tracks(sp_playlist *src, sp_playlist *dst);
 
 #endif
@@ -33,6 +33,13 @@
  * */
 
 #include "listify.h"
+#include "cmd.h"
+#include "cblog.h"
+#include "timer.h"
+#include "pending.h"
+
+/// How long logout waits for the changes to be synced, see cmd_logout()
+#define LOGOUT_SYNC_MS 30000
 
 sp_session *g_session;
 void (*metadata_updated_fn)(void);
@@ -47,6 +54,7 @@ void (*metadata_updated_fn)(void);
  */
 static void connection_error(sp_session *session, sp_error error)
 {
+	cblog_connection_error(error);
 	fprintf(stderr, "Connection to Spotify failed: %s\n",
 	                sp_error_message(error));
 }
@@ -61,6 +69,7 @@ static void logged_in(sp_session *session, sp_error error)
 	sp_user *me;
 	const char *my_name;
 
+	cblog_logged_in(session, error);
 	if (SP_ERROR_OK != error) {
 		fprintf(stderr, "failed to log in to Spotify: %s\n",
 		                sp_error_message(error));
@@ -78,7 +87,8 @@ static void logged_in(sp_session *session, sp_error error)
 	// error == OK is true by now.
 	logged_in_playlist(session);
 
-	start_prompt();
+	// The prompt is already running, release what was queued.
+	cmd_session_ready();
 }
 
 /**
@@ -88,6 +98,7 @@ static void logged_in(sp_session *session, sp_error error)
  */
 static void logged_out(sp_session *session)
 {
+	cblog_logged_out();
 	exit(0);
 }
 
@@ -99,6 +110,7 @@ static void logged_out(sp_session *session)
  */
 static void log_message(sp_session *session, const char *data)
 {
+	cblog_log_message(data);
 	fprintf(stderr, "%s", data);
 }
 
@@ -114,6 +126,7 @@ static void log_message(sp_session *session, const char *data)
  */
 static void metadata_updated(sp_session *sess)
 {
+	cblog_metadata_updated();
 	if(metadata_updated_fn)
 		metadata_updated_fn();
 }
@@ -136,8 +149,8 @@ static sp_session_callbacks callbacks = {
 
 /**
  * Added note: The callbacks for the playlist-handling are set
- *             by logged_in_playlist(), for each playlist in the
- *             playlist container.
+ *             by playlist_touch(), for each playlist that
+ *             gets used.
  * 
  *             The callbacks for the playlist-container-handling are set
  *             by main().
@@ -207,11 +220,38 @@ int spshell_init(const char *username, const char *password)
 }
 
 
+static struct pending_waiter logout_waiter;
+static struct timer logout_timer;
+
+static void logout_synced(struct pending_waiter *w)
+{
+	timer_cancel(&logout_timer);
+	sp_session_logout(g_session);
+}
+
+static void logout_expired(struct timer *t)
+{
+	pending_cancel(&logout_waiter);
+	fprintf(stderr, "%d changes are still not synced, logging out anyway.\n",
+	        pending_changes());
+	sp_session_logout(g_session);
+}
+
 /**
- *
+ * Logout, once the changes we have made are synced, or LOGOUT_SYNC_MS
+ * have passed. logged_out() exits, and what libspotify still has then
+ * is lost.
  */
 int cmd_logout(int argc, char **argv)
 {
-	sp_session_logout(g_session);
+	if(pending_waiting(&logout_waiter))
+		return 0;
+	if(pending_playlists()) {
+		printf("Waiting for %d changes to be synced before logging out.\n",
+		       pending_changes());
+		fflush(stdout);
+		timer_add(&logout_timer, &logout_expired, LOGOUT_SYNC_MS);
+	}
+	pending_wait(&logout_waiter, &logout_synced);
 	return 0;
 }
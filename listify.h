@@ -42,6 +42,8 @@ extern int spshell_init(const char *username, const char *password);
 
 extern void notify_main_thread(sp_session *session);
 
+extern void notify_work_done(void);
+
 extern void start_prompt(void);
 
 extern void logged_in_playlist(sp_session* session);
@@ -32,10 +32,18 @@
 
 #include "listify.h"
 #include "cmd.h"
+#include "stats.h"
+#include "list.h"
+#include "pool.h"
+#include "timer.h"
+#include "cblog.h"
 
 /// Set when libspotify want to process events
 static int notify_events;
 
+/// Set when the thread pool has completions to run
+static int notify_work;
+
 /// Synchronization mutex to protect various shared data
 static pthread_mutex_t notify_mutex;
 
@@ -51,6 +59,9 @@ static char *cmdline;
 /// 
 static int show_prompt;
 
+/// Set while a command runs, until cmd_done() is called
+static int cmd_busy;
+
 /**
  *
  */
@@ -61,9 +72,11 @@ static void *promptloop(void *aux)
 	while(1) {
 		char *l;
 
-		while(show_prompt == 0)
+		// A line that has not been taken yet is not to be overwritten
+		while(show_prompt == 0 || cmdline)
 			pthread_cond_wait(&prompt_cond, &notify_mutex);
 
+		stats_first_prompt();
 		pthread_mutex_unlock(&notify_mutex);
 		l = readline("> ");
 		pthread_mutex_lock(&notify_mutex);
@@ -105,12 +118,29 @@ static void trim(char *buf)
  */
 int main(int argc, char **argv)
 {
-	const char *username = argc > 1 ? argv[1] : NULL;
-	const char *password = argc > 2 ? argv[2] : NULL;
+	const char *username;
+	const char *password;
 	char username_buf[256];
 	int r;
 	int next_timeout = 0;
 
+	stats_startup_begin();
+
+	// Only check a script, which needs no session
+	if (argc == 3 && !strcmp(argv[1], "--check"))
+		return cmd_check_script(argv[2]) ? 1 : 0;
+
+	// Log the callbacks, for "loadgen -R" to replay
+	if (argc > 2 && !strcmp(argv[1], "--record")) {
+		if (cblog_open(argv[2]))
+			exit(1);
+		argc -= 2;
+		argv += 2;
+	}
+
+	username = argc > 1 ? argv[1] : NULL;
+	password = argc > 2 ? argv[2] : NULL;
+
 	if (username == NULL) {
 		printf("Username: ");
 		fflush(stdout);
@@ -129,13 +159,18 @@ int main(int argc, char **argv)
 	if ((r = spshell_init(username, password)) != 0)
 		exit(r);
 
+	// Take commands right away, those that need the session or the
+	// playlist container wait in a queue until they are ready.
+	start_prompt();
+
 	pthread_mutex_lock(&notify_mutex);
 
 	for (;;) {
 		// Release prompt
 
 		if (next_timeout == 0) {
-			while(!notify_events && !cmdline)
+			while(!notify_events && !notify_work &&
+			      (cmd_busy || (!cmdline && !cmd_queue_ready())))
 				pthread_cond_wait(&notify_cond, &notify_mutex);
 		} else {
 			struct timespec ts;
@@ -151,16 +186,19 @@ int main(int argc, char **argv)
 			ts.tv_sec += next_timeout / 1000;
 			ts.tv_nsec += (next_timeout % 1000) * 1000000;
 
-			while(!notify_events && !cmdline) {
+			while(!notify_events && !notify_work &&
+			      (cmd_busy || (!cmdline && !cmd_queue_ready()))) {
 				if(pthread_cond_timedwait(&notify_cond, &notify_mutex, &ts))
 					break;
 			}
 		}
 
-		// Process input from prompt
-		if(cmdline) {
+		// Process input from prompt. A queued command may be running,
+		// which the prompt was up for, then the line waits for it.
+		if(cmdline && !cmd_busy) {
 			char *l = cmdline;
 			cmdline = NULL;
+			cmd_busy = 1;
 		
 			pthread_mutex_unlock(&notify_mutex);
 			cmd_exec_unparsed(l);
@@ -168,6 +206,22 @@ int main(int argc, char **argv)
 			pthread_mutex_lock(&notify_mutex);
 		}
 
+		// Finish the work done by the thread pool
+		if(notify_work) {
+			notify_work = 0;
+			pthread_mutex_unlock(&notify_mutex);
+			pool_run_completions();
+			pthread_mutex_lock(&notify_mutex);
+		}
+
+		// Run what was queued while we were logging in
+		if(!cmd_busy && cmd_queue_ready()) {
+			cmd_busy = 1;
+			pthread_mutex_unlock(&notify_mutex);
+			cmd_run_queued();
+			pthread_mutex_lock(&notify_mutex);
+		}
+
 		// Process libspotify events
 		notify_events = 0;
 		pthread_mutex_unlock(&notify_mutex);
@@ -176,6 +230,16 @@ int main(int argc, char **argv)
 			sp_session_process_events(g_session, &next_timeout);
 		} while (next_timeout == 0);
 
+		// Drop the playlist callbacks that haven't been used for a while
+		r = playlist_expire_idle();
+		if(r >= 0 && r < next_timeout)
+			next_timeout = r;
+
+		// Give up on the commands that waited too long, and the like
+		r = timer_run();
+		if(r >= 0 && r < next_timeout)
+			next_timeout = r;
+
 		pthread_mutex_lock(&notify_mutex);
 	}
 	return 0;
@@ -186,9 +250,16 @@ int main(int argc, char **argv)
  */
 void cmd_done(void)
 {
+	stats_command_done();
 	pthread_mutex_lock(&notify_mutex);
-	show_prompt = 1;
-	pthread_cond_signal(&prompt_cond);
+	cmd_busy = 0;
+	// With a line waiting to be run, the prompt comes back after it
+	if(!cmdline) {
+		show_prompt = 1;
+		pthread_cond_signal(&prompt_cond);
+	}
+	// The main loop may have queued commands waiting for us
+	pthread_cond_signal(&notify_cond);
 	pthread_mutex_unlock(&notify_mutex);
 }
 
@@ -198,8 +269,21 @@ void cmd_done(void)
  */
 void notify_main_thread(sp_session *session)
 {
+	cblog_notify_main_thread();
 	pthread_mutex_lock(&notify_mutex);
 	notify_events = 1;
 	pthread_cond_signal(&notify_cond);
 	pthread_mutex_unlock(&notify_mutex);
 }
+
+
+/**
+ * Called by the thread pool when it has completions for us to run
+ */
+void notify_work_done(void)
+{
+	pthread_mutex_lock(&notify_mutex);
+	notify_work = 1;
+	pthread_cond_signal(&notify_cond);
+	pthread_mutex_unlock(&notify_mutex);
+}
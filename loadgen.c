@@ -0,0 +1,803 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "listify.h"
+#include "cmd.h"
+#include "stats.h"
+#include "list.h"
+#include "lines.h"
+#include "pool.h"
+#include "timer.h"
+#include "uri.h"
+#include "replay.h"
+#include "cblog.h"
+
+
+/*
+ * loadgen pushes a known workload through listify, and tells how fast
+ * it went. It takes the place of listify_posix.c: the commands of a
+ * trace go through cmd_exec_unparsed() just as typed ones do, against
+ * the libspotify stand-in of fakespotify.c, so it needs neither the
+ * network nor an account.
+ *
+ * The trace is a script, one command per line, or is made up from a
+ * mix of new_list, add_tracks, clear_list and hide_list (see
+ * make_trace()). The commands arrive either at a given rate, spaced
+ * as a Poisson process (open loop), or from a number of clients that
+ * each send the next command when their last one is done (closed
+ * loop). listify runs one command at a time, so the others wait, and
+ * the latency of a command is from when it arrived until its
+ * cmd_done(), waiting included.
+ *
+ * Before the trace, every playlist URI in it is added to the
+ * container, and that isn't measured.
+ *
+ * With -R, a callback log of "listify --record" is replayed instead,
+ * see replay.c.
+ *
+ * */
+
+/// Room for one URI of a generated command, with its space
+#define TRACE_ARG_ROOM 64
+
+/// The commands of the mix, in the order of the weights of -m
+static const char *const MIX_NAMES[] = {
+	"new_list", "add_tracks", "clear_list", "hide_list"
+};
+#define MIX_SIZE (sizeof(MIX_NAMES) / sizeof(MIX_NAMES[0]))
+
+/// How many tokens of a command make up its name in the report
+#define NAME_SIZE 24
+
+/*
+ * How many of something a generated command gets: always min if max
+ * is 0, else uniform from min to max, or geometric with the given
+ * mean if that is set.
+ */
+struct dist {
+	int min;
+	int max;
+	double mean;
+};
+
+struct op {
+	char *line;
+	uint64_t arrival;
+	uint64_t started;
+	uint64_t done;
+	char name[NAME_SIZE];
+};
+
+/* --- Options --- */
+static double opt_rate;
+static int opt_clients = 1;
+static int opt_count = 10000;
+static int opt_playlists = 100;
+static int opt_universe = 100000;
+static unsigned int opt_mix[MIX_SIZE] = { 10, 60, 20, 10 };
+static struct dist opt_tracks = { 1, 30, 0 };
+static struct dist opt_targets = { 1, 0, 0 };
+static uint64_t opt_seed = 1;
+static int opt_verbose;
+static const char *opt_replay;
+static const char *opt_record;
+static double opt_speed = 1;
+
+/* --- The run --- */
+static struct op *ops;
+static int num_ops;
+static int admitted;      // ops that have arrived
+static int started;       // ops that have been started
+static int finished;      // ops that are done
+static struct op *running;
+static int clients;       // 0 for open loop
+
+/// Ops listify has queued, in its order, done only once they have run
+static struct op **waiting;
+static int waiting_head, waiting_tail;
+static int queue_seen;    // cmd_queue_length() when the last op was done
+
+static int notify_events;
+static int notify_work;
+static pthread_mutex_t notify_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t notify_cond = PTHREAD_COND_INITIALIZER;
+
+static int container_is_loaded;
+
+/// The stand-in takes any application key
+const char g_appkey[] = { 0 };
+const size_t g_appkey_size = sizeof(g_appkey);
+
+
+/* ---------------------------- MAKING A TRACE ------------------------------ */
+
+static uint64_t rng_state;
+
+/**
+ * xorshift64*, so that a seed makes the same trace everywhere.
+ */
+static uint64_t rng_next(void){
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return rng_state * 0x2545f4914f6cdd1dULL;
+}
+
+
+/// Uniform in [0, 1)
+static double rng_unit(void){
+	return (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+static int rng_below(int n){
+	return n > 0 ? (int)(rng_unit() * n) : 0;
+}
+
+
+static int dist_draw(const struct dist *d){
+	int n;
+	if(d->mean > 0)
+		n = d->min + (int)(log(1 - rng_unit()) / log(1 - 1 / (d->mean - d->min + 1)));
+	else if(d->max > d->min)
+		n = d->min + rng_below(d->max - d->min + 1);
+	else
+		n = d->min;
+	return n;
+}
+
+
+/**
+ * Make a line at least need long, a command of the trace has as many
+ * URIs as its distribution draws.
+ */
+static char *line_room(char *line, size_t *size, size_t need){
+	if(need <= *size)
+		return line;
+	line = realloc(line, need);
+	if(!line){
+		fprintf(stderr, "loadgen: out of memory\n");
+		exit(1);
+	}
+	*size = need;
+	return line;
+}
+
+
+/**
+ * Parse a distribution: "N", "MIN-MAX" or "MIN~MEAN".
+ *
+ * @return -1 if it's none of them.
+ */
+static int dist_parse(const char *s, struct dist *d){
+	char *end;
+	d->min = strtol(s, &end, 10);
+	d->max = 0;
+	d->mean = 0;
+	if(end == s || d->min < 1)
+		return -1;
+	if(*end == '-')
+		d->max = strtol(end + 1, &end, 10);
+	else if(*end == '~')
+		d->mean = strtod(end + 1, &end);
+	if(*end || (d->max && d->max < d->min) || (d->mean && d->mean < d->min))
+		return -1;
+	return 0;
+}
+
+
+/**
+ * Parse the weights of the mix, like "new_list=10,add_tracks=60".
+ * The commands left out get 0.
+ */
+static int mix_parse(char *s){
+	unsigned int i;
+	char *tok;
+	memset(opt_mix, 0, sizeof(opt_mix));
+	for(tok = strtok(s, ","); tok; tok = strtok(NULL, ",")){
+		char *eq = strchr(tok, '=');
+		if(!eq)
+			return -1;
+		*eq = 0;
+		for(i = 0; i < MIX_SIZE && strcmp(tok, MIX_NAMES[i]); i++)
+			;
+		if(i == MIX_SIZE)
+			return -1;
+		opt_mix[i] = atoi(eq + 1);
+	}
+	for(i = 0; i < MIX_SIZE; i++)
+		if(opt_mix[i])
+			return 0;
+	return -1;
+}
+
+
+static void format_id(char *buf, uint64_t hi, uint64_t lo){
+	struct spid id = { hi, lo };
+	spid_encode(&id, buf);
+}
+
+
+/**
+ * Make up a trace of opt_count commands from the mix.
+ *
+ * The playlists are opt_playlists made up URIs, the tracks are drawn
+ * from opt_universe made up URIs. hide_list only hides playlists in
+ * the container, and when half of them are hidden an add_list puts
+ * one back, so that the container keeps its size.
+ */
+static void make_trace(void){
+	char (*pool)[64] = malloc(opt_playlists * sizeof(*pool));
+	int *order = malloc(opt_playlists * sizeof(*order));
+	unsigned int total = 0;
+	int visible = opt_playlists;
+	int i, j, k;
+	size_t size = 0;
+	char *line = line_room(NULL, &size, 2 * TRACE_ARG_ROOM);
+
+	ops = calloc(opt_count, sizeof(*ops));
+	if(!pool || !order || !ops){
+		fprintf(stderr, "loadgen: out of memory\n");
+		exit(1);
+	}
+	for(i = 0; i < opt_playlists; i++){
+		char id[SPID_LENGTH + 1];
+		format_id(id, 0x6c6f6164, i + 1); // "load"
+		snprintf(pool[i], sizeof(pool[i]), "spotify:user:loadgen:playlist:%s", id);
+		order[i] = i;
+	}
+	for(i = 0; i < MIX_SIZE; i++)
+		total += opt_mix[i];
+
+	for(num_ops = 0; num_ops < opt_count; num_ops++){
+		int len = 0;
+		unsigned int w = rng_next() % total;
+		int what;
+		for(what = 0; w >= opt_mix[what]; what++)
+			w -= opt_mix[what];
+
+		if(visible < opt_playlists / 2){
+			// Put back a hidden one
+			j = visible + rng_below(opt_playlists - visible);
+			k = order[j]; order[j] = order[visible]; order[visible++] = k;
+			len = snprintf(line, size, "add_list %s", pool[k]);
+		} else if(what == 0){
+			len = snprintf(line, size, "new_list load_%d", num_ops);
+		} else if(what == 1){
+			int n = dist_draw(&opt_tracks);
+			line = line_room(line, &size, (n + 1) * TRACE_ARG_ROOM);
+			len = snprintf(line, size, "add_tracks %s", pool[rng_below(opt_playlists)]);
+			for(i = 0; i < n; i++){
+				char id[SPID_LENGTH + 1];
+				format_id(id, 0x74726b, rng_below(opt_universe) + 1); // "trk"
+				len += snprintf(line + len, size - len, " spotify:track:%s", id);
+			}
+		} else {
+			int n = dist_draw(&opt_targets);
+			line = line_room(line, &size, (n + 1) * TRACE_ARG_ROOM);
+			len = snprintf(line, size, "%s", MIX_NAMES[what]);
+			if(what == 3 && n > visible - 1)
+				n = visible - 1 > 0 ? visible - 1 : 1;
+			for(i = 0; i < n; i++){
+				if(what == 3 && visible > 1){
+					// Hide one in the container
+					j = rng_below(visible);
+					k = order[j]; order[j] = order[visible - 1]; order[--visible] = k;
+				} else {
+					k = rng_below(opt_playlists);
+				}
+				len += snprintf(line + len, size - len, " %s", pool[k]);
+			}
+		}
+		ops[num_ops].line = strdup(line);
+		if(!ops[num_ops].line){
+			fprintf(stderr, "loadgen: out of memory\n");
+			exit(1);
+		}
+	}
+	free(pool);
+	free(order);
+	free(line);
+}
+
+
+/**
+ * Read the trace from a script.
+ */
+static void read_trace(const char *path){
+	static struct lines lines;
+	int i;
+	if(lines_read(path, &lines))
+		exit(1);
+	num_ops = opt_count < lines.num ? opt_count : lines.num;
+	ops = calloc(num_ops ? num_ops : 1, sizeof(*ops));
+	if(!ops){
+		fprintf(stderr, "loadgen: out of memory\n");
+		exit(1);
+	}
+	for(i = 0; i < num_ops; i++)
+		ops[i].line = lines.line[i];
+}
+
+
+static int compare_str(const void *a, const void *b){
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+
+/**
+ * The add_list commands for every playlist the trace names, once each.
+ *
+ * @return how many there are, the lines are put in *out.
+ */
+static int setup_trace(struct op **out){
+	char **uris = NULL;
+	int num = 0, cap = 0;
+	int i, j;
+	for(i = 0; i < num_ops; i++){
+		char *copy = strdup(ops[i].line), *tok, *save;
+		for(tok = strtok_r(copy, " \t", &save); tok; tok = strtok_r(NULL, " \t", &save)){
+			if(uri_parse(tok, NULL) != URI_PLAYLIST)
+				continue;
+			if(num == cap){
+				cap = cap ? cap * 2 : 64;
+				uris = realloc(uris, cap * sizeof(*uris));
+			}
+			uris[num++] = strdup(tok);
+		}
+		free(copy);
+	}
+	if(num)
+		qsort(uris, num, sizeof(*uris), compare_str);
+	*out = calloc(num ? num : 1, sizeof(**out));
+	for(i = j = 0; i < num; i++){
+		if(i && !strcmp(uris[i], uris[i - 1]))
+			continue;
+		(*out)[j].line = malloc(strlen(uris[i]) + 10);
+		sprintf((*out)[j++].line, "add_list %s", uris[i]);
+	}
+	for(i = 0; i < num; i++)
+		free(uris[i]);
+	free(uris);
+	return j;
+}
+
+
+/* ------------------------------ RUNNING IT -------------------------------- */
+
+/**
+ * The exponential gap to the next arrival at opt_rate a second.
+ */
+static uint64_t next_gap(void){
+	return (uint64_t)(-log(1 - rng_unit()) / opt_rate * 1000000);
+}
+
+
+static void start(struct op *op){
+	size_t n = strcspn(op->line, " \t");
+	if(n >= NAME_SIZE)
+		n = NAME_SIZE - 1;
+	memcpy(op->name, op->line, n);
+	op->name[n] = 0;
+	running = op;
+	started++;
+	op->started = stats_now_usec();
+	cmd_exec_unparsed(op->line);
+}
+
+
+/**
+ * Wait for libspotify or the pool to have something for us, at most
+ * ms milliseconds, forever if ms is negative.
+ */
+static void wait_notify(int ms){
+	pthread_mutex_lock(&notify_mutex);
+	if(ms < 0){
+		while(!notify_events && !notify_work)
+			pthread_cond_wait(&notify_cond, &notify_mutex);
+	} else {
+		struct timespec ts;
+#if _POSIX_TIMERS > 0
+		clock_gettime(CLOCK_REALTIME, &ts);
+#else
+		struct timeval tv;
+		gettimeofday(&tv, NULL);
+		TIMEVAL_TO_TIMESPEC(&tv, &ts);
+#endif
+		ts.tv_sec += ms / 1000;
+		ts.tv_nsec += (ms % 1000) * 1000000;
+		if(ts.tv_nsec >= 1000000000){
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+		while(!notify_events && !notify_work)
+			if(pthread_cond_timedwait(&notify_cond, &notify_mutex, &ts))
+				break;
+	}
+	pthread_mutex_unlock(&notify_mutex);
+}
+
+
+/**
+ * Run the main loop until stop() says so, or until all n ops are
+ * done if stop is NULL.
+ */
+static void run(struct op *v, int n, int (*stop)(void)){
+	uint64_t t0 = stats_now_usec();
+	uint64_t next_events = 0;
+	int i;
+
+	ops = v;
+	num_ops = n;
+	started = finished = 0;
+	waiting = realloc(waiting, (n ? n : 1) * sizeof(*waiting));
+	waiting_head = waiting_tail = 0;
+	queue_seen = cmd_queue_length();
+	if(!waiting){
+		fprintf(stderr, "loadgen: out of memory\n");
+		exit(1);
+	}
+	if(clients){
+		admitted = clients < n ? clients : n;
+		for(i = 0; i < admitted; i++)
+			v[i].arrival = t0;
+	} else {
+		uint64_t t = t0;
+		admitted = 0;
+		for(i = 0; i < n; i++){
+			t += next_gap();
+			v[i].arrival = t;
+		}
+	}
+
+	while(stop ? !stop() : finished < n){
+		uint64_t now = stats_now_usec();
+		int wait = -1, r, work;
+
+		if(!clients)
+			while(admitted < n && v[admitted].arrival <= now)
+				admitted++;
+		if(!running && waiting_head < waiting_tail && cmd_queue_ready()){
+			running = waiting[waiting_head++];
+			cmd_run_queued();
+			continue;
+		}
+		if(!running && started < admitted){
+			start(&v[started]);
+			continue;
+		}
+
+		pthread_mutex_lock(&notify_mutex);
+		work = notify_work;
+		notify_work = 0;
+		if(notify_events)
+			next_events = 0;
+		notify_events = 0;
+		pthread_mutex_unlock(&notify_mutex);
+
+		if(work)
+			pool_run_completions();
+		if(now >= next_events){
+			int next_timeout;
+			do {
+				sp_session_process_events(g_session, &next_timeout);
+			} while(next_timeout == 0);
+			next_events = now + next_timeout * 1000ULL;
+		}
+		if(!running && started < admitted)
+			continue;
+
+		wait = (next_events - now) / 1000;
+		r = playlist_expire_idle();
+		if(r >= 0 && r < wait)
+			wait = r;
+		r = timer_run();
+		if(r >= 0 && r < wait)
+			wait = r;
+		if(!clients && !running && admitted < n){
+			r = (v[admitted].arrival - now) / 1000;
+			if(r < wait)
+				wait = r;
+		}
+		if(opt_replay){
+			r = replay_run_due();
+			if(r >= 0 && r < wait)
+				wait = r;
+		}
+		if(stop ? !stop() : finished < n)
+			wait_notify(wait);
+	}
+}
+
+
+static int container_loaded_yet(void){
+	return container_is_loaded;
+}
+
+
+/**
+ * The main loop must know when it can start the trace.
+ */
+static void container_loaded(sp_playlistcontainer *pc, void *userdata){
+	container_is_loaded = 1;
+}
+
+static sp_playlistcontainer_callbacks loadgen_callbacks = {
+	.container_loaded = &container_loaded,
+};
+
+
+/* ------------------------------- REPORTING -------------------------------- */
+
+static int compare_u64(const void *a, const void *b){
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+
+/**
+ * The q quantile of the sorted v, by nearest rank, in ms.
+ */
+static double quantile(const uint64_t *v, int n, double q){
+	int i = (int)ceil(q * n) - 1;
+	if(i < 0)
+		i = 0;
+	return v[i] / 1000.0;
+}
+
+
+static void report_row(FILE *f, const char *name, uint64_t *lat, int n){
+	if(!n)
+		return;
+	qsort(lat, n, sizeof(*lat), compare_u64);
+	fprintf(f, "  %-16s %8d %10.3f %10.3f %10.3f %10.3f\n", name, n,
+	        quantile(lat, n, 0.5), quantile(lat, n, 0.99),
+	        quantile(lat, n, 0.999), lat[n - 1] / 1000.0);
+}
+
+
+/**
+ * Throughput and latency percentiles, over all and for each command.
+ */
+static void report(FILE *f, uint64_t elapsed){
+	uint64_t *lat = malloc((num_ops ? num_ops : 1) * sizeof(*lat));
+	const char *names[64];
+	int num_names = 0;
+	int i, j, n;
+
+	fprintf(f, "loadgen: %d commands in %.3f s, %.1f commands/s", num_ops,
+	        elapsed / 1e6, elapsed ? num_ops * 1e6 / elapsed : 0);
+	if(clients)
+		fprintf(f, " (closed loop, %d clients)\n", clients);
+	else
+		fprintf(f, " (open loop, %.1f/s offered)\n", opt_rate);
+	fprintf(f, "  %-16s %8s %10s %10s %10s %10s\n", "latency ms", "count",
+	        "p50", "p99", "p99.9", "max");
+
+	for(i = 0; i < num_ops; i++)
+		lat[i] = ops[i].done - ops[i].arrival;
+	report_row(f, "all", lat, num_ops);
+
+	for(i = 0; i < num_ops; i++){
+		for(j = 0; j < num_names && strcmp(names[j], ops[i].name); j++)
+			;
+		if(j == num_names && num_names < 64)
+			names[num_names++] = ops[i].name;
+	}
+	for(j = 0; j < num_names; j++){
+		for(i = n = 0; i < num_ops; i++)
+			if(!strcmp(names[j], ops[i].name))
+				lat[n++] = ops[i].done - ops[i].arrival;
+		report_row(f, names[j], lat, n);
+	}
+
+	for(i = 0; i < num_ops; i++)
+		lat[i] = ops[i].done - ops[i].started;
+	report_row(f, "service", lat, num_ops);
+	free(lat);
+}
+
+
+/* ------------------------------ LISTIFY GLUE ------------------------------ */
+
+/**
+ * What listify_posix.c does when a command is done, and the end of
+ * its measurement.
+ */
+void cmd_done(void)
+{
+	uint64_t now = stats_now_usec();
+	stats_command_done();
+	if(!running)
+		return;
+	if(cmd_queue_length() > queue_seen){
+		// Queued, it's done when it has run
+		waiting[waiting_tail++] = running;
+		queue_seen = cmd_queue_length();
+		running = NULL;
+		return;
+	}
+	queue_seen = cmd_queue_length();
+	running->done = now;
+	running = NULL;
+	finished++;
+	if(clients && admitted < num_ops)
+		ops[admitted++].arrival = now;
+}
+
+
+void notify_main_thread(sp_session *session)
+{
+	cblog_notify_main_thread();
+	pthread_mutex_lock(&notify_mutex);
+	notify_events = 1;
+	pthread_cond_signal(&notify_cond);
+	pthread_mutex_unlock(&notify_mutex);
+}
+
+
+void notify_work_done(void)
+{
+	pthread_mutex_lock(&notify_mutex);
+	notify_work = 1;
+	pthread_cond_signal(&notify_cond);
+	pthread_mutex_unlock(&notify_mutex);
+}
+
+
+static void usage(int status)
+{
+	fprintf(status ? stderr : stdout,
+	        "Usage: loadgen [options]\n"
+	        "  -t <file>    the trace, a script, instead of a made up one\n"
+	        "  -o <file>    write the made up trace to a file, to run it again with -t\n"
+	        "  -n <count>   how many commands (%d)\n"
+	        "  -r <rate>    commands a second, arriving at random (open loop)\n"
+	        "  -c <count>   clients, each waiting for its last command (closed loop, %d)\n"
+	        "  -m <mix>     weights, like new_list=10,add_tracks=60,clear_list=20,hide_list=10\n"
+	        "  -k <dist>    tracks per add_tracks: N, MIN-MAX or MIN~MEAN (1-30)\n"
+	        "  -g <dist>    playlists per clear_list and hide_list (1)\n"
+	        "  -p <count>   playlists of the made up trace (%d)\n"
+	        "  -u <count>   tracks of the made up trace (%d)\n"
+	        "  -s <seed>    for the made up trace and the arrivals (1)\n"
+	        "  -w <file>    log the callbacks, as listify --record does\n"
+	        "  -R <file>    replay a callback log of listify --record instead\n"
+	        "  -x <speed>   times the recorded speed of the replay, 0 for flat out (1)\n"
+	        "  -v           show what listify prints\n"
+	        "  -h           this help\n",
+	        opt_count, opt_clients, opt_playlists, opt_universe);
+	exit(status);
+}
+
+
+/**
+ * loadgen -R: the log gives the callbacks, there are no commands.
+ */
+static int replay_main(void)
+{
+	int out, r;
+
+	if(replay_open(opt_replay, opt_speed))
+		return 1;
+	fflush(stdout);
+	out = dup(1);
+	if(!opt_verbose && !freopen("/dev/null", "w", stdout)){
+		perror("/dev/null");
+		exit(1);
+	}
+	if((r = spshell_init("loadgen", "")) != 0)
+		exit(r);
+	stats_first_prompt();
+
+	clients = 1;
+	uint64_t t0 = stats_now_usec();
+	run(NULL, 0, replay_finished);
+	uint64_t elapsed = stats_now_usec() - t0;
+
+	fflush(stdout);
+	FILE *f = fdopen(out, "w");
+	replay_report(f ? f : stderr, elapsed);
+	if(f)
+		fclose(f);
+	return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+	const char *trace = NULL, *save = NULL;
+	struct op *setup;
+	int num_setup, out;
+	int c, r;
+
+	stats_startup_begin();
+
+	while((c = getopt(argc, argv, "t:o:n:r:c:m:k:g:p:u:s:w:R:x:vh")) != -1){
+		switch(c){
+		case 't': trace = optarg; break;
+		case 'o': save = optarg; break;
+		case 'n': opt_count = atoi(optarg); break;
+		case 'r': opt_rate = atof(optarg); break;
+		case 'c': opt_clients = atoi(optarg); break;
+		case 'm': if(mix_parse(optarg)) usage(1); break;
+		case 'k': if(dist_parse(optarg, &opt_tracks)) usage(1); break;
+		case 'g': if(dist_parse(optarg, &opt_targets)) usage(1); break;
+		case 'p': opt_playlists = atoi(optarg); break;
+		case 'u': opt_universe = atoi(optarg); break;
+		case 's': opt_seed = strtoull(optarg, NULL, 0); break;
+		case 'w': opt_record = optarg; break;
+		case 'R': opt_replay = optarg; break;
+		case 'x': opt_speed = atof(optarg); break;
+		case 'v': opt_verbose = 1; break;
+		case 'h': usage(0);
+		default: usage(1);
+		}
+	}
+	if(optind != argc || opt_count < 1 || opt_clients < 1 || opt_rate < 0 ||
+	   opt_playlists < 2 || opt_universe < 1 || opt_speed < 0)
+		usage(1);
+	rng_state = opt_seed ? opt_seed : 1;
+
+	if(opt_replay)
+		return replay_main();
+
+	if(trace)
+		read_trace(trace);
+	else
+		make_trace();
+	if(save){
+		FILE *f = fopen(save, "w");
+		int i;
+		if(!f){
+			perror(save);
+			exit(1);
+		}
+		for(i = 0; i < num_ops; i++)
+			fprintf(f, "%s\n", ops[i].line);
+		fclose(f);
+	}
+
+	struct op *trace_ops = ops;
+	int num_trace = num_ops;
+	num_setup = setup_trace(&setup);
+
+	// What listify prints would swamp the numbers
+	fflush(stdout);
+	out = dup(1);
+	if(!opt_verbose && !freopen("/dev/null", "w", stdout)){
+		perror("/dev/null");
+		exit(1);
+	}
+
+	if(opt_record && cblog_open(opt_record))
+		exit(1);
+	if((r = spshell_init("loadgen", "")) != 0)
+		exit(r);
+	sp_playlistcontainer_add_callbacks(sp_session_playlistcontainer(g_session),
+	                                   &loadgen_callbacks, NULL);
+	stats_first_prompt();
+
+	// Log in and add the playlists, one at a time
+	clients = 1;
+	run(NULL, 0, container_loaded_yet);
+	run(setup, num_setup, NULL);
+
+	clients = opt_rate > 0 ? 0 : opt_clients;
+	uint64_t t0 = stats_now_usec();
+	run(trace_ops, num_trace, NULL);
+	uint64_t elapsed = stats_now_usec() - t0;
+	cblog_close();
+
+	fflush(stdout);
+	FILE *f = fdopen(out, "w");
+	report(f ? f : stderr, elapsed);
+	if(f)
+		fclose(f);
+	return 0;
+}
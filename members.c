@@ -0,0 +1,310 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "listify.h"
+#include "list.h"
+#include "ptrmap.h"
+#include "members.h"
+
+
+/*
+ * Which tracks a playlist has, for "--unique" adds, so that tracks
+ * already in it are left out before libspotify sees them.
+ *
+ * The set of a playlist is built the first time an add asks for it,
+ * and from then on kept current by the playlist callbacks, for as long
+ * as we have them (see playlist_touch()). It is an exact count of each
+ * track, with a Bloom filter in front: most tracks of a feed are new,
+ * and for those the filter says so from a few bits, without looking
+ * the track up. A track the filter may have is looked up to be sure.
+ *
+ * A Bloom filter can't forget, so removed tracks keep their bits.
+ * When there are more of those than tracks, or the playlist has
+ * outgrown the filter, it's made again from our copy of the playlist.
+ * That copy, of the track order, is also what tells which tracks the
+ * tracks_removed callback took away, as it only gives their indices.
+ * Moves are rare, so the copy is simply read again for them.
+ *
+ * */
+
+/// Bits of the filter for each track, which makes ~1 false hit in 400
+#define BLOOM_BITS_PER_TRACK 16
+
+/// Bits looked at for each track
+#define BLOOM_HASHES 4
+
+/// The least the filter is sized for
+#define BLOOM_MIN_TRACKS 64
+
+struct members {
+	int num;
+	int cap;
+	sp_track **t;         // our copy of the track order
+	struct ptrmap count;  // sp_track* --> how many times it's in
+	uint64_t *bloom;
+	unsigned int bloom_bits; // a power of two
+	int stale;            // removed tracks the filter still has
+};
+
+/// sp_playlist* --> struct members*
+static struct ptrmap by_playlist;
+
+
+static uint64_t mix(const void *p){
+	uint64_t h = (uintptr_t)p;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+
+static void bloom_add(struct members *m, sp_track *track){
+	uint64_t h = mix(track);
+	uint32_t h1 = h, h2 = (h >> 32) | 1;
+	int k;
+	for(k = 0; k < BLOOM_HASHES; k++){
+		uint32_t bit = (h1 + k * h2) & (m->bloom_bits - 1);
+		m->bloom[bit >> 6] |= 1ULL << (bit & 63);
+	}
+}
+
+
+static int bloom_maybe(const struct members *m, sp_track *track){
+	uint64_t h = mix(track);
+	uint32_t h1 = h, h2 = (h >> 32) | 1;
+	int k;
+	for(k = 0; k < BLOOM_HASHES; k++){
+		uint32_t bit = (h1 + k * h2) & (m->bloom_bits - 1);
+		if(!(m->bloom[bit >> 6] & (1ULL << (bit & 63))))
+			return 0;
+	}
+	return 1;
+}
+
+
+/**
+ * Make the filter again from the tracks, sized for twice as many.
+ *
+ * @return -1 if out of memory, then the filter says yes to everything.
+ * */
+static int bloom_build(struct members *m){
+	unsigned int bits = 64;
+	int n = m->num > BLOOM_MIN_TRACKS ? m->num : BLOOM_MIN_TRACKS;
+	int i;
+	while(bits < 2u * BLOOM_BITS_PER_TRACK * n)
+		bits *= 2;
+	free(m->bloom);
+	m->bloom = calloc(bits / 64, sizeof(uint64_t));
+	m->stale = 0;
+	if(!m->bloom){
+		// One bit, always set
+		m->bloom = malloc(sizeof(uint64_t));
+		m->bloom_bits = 1;
+		if(!m->bloom)
+			return -1;
+		m->bloom[0] = 1;
+		return -1;
+	}
+	m->bloom_bits = bits;
+	for(i = 0; i < m->num; i++)
+		bloom_add(m, m->t[i]);
+	return 0;
+}
+
+
+/**
+ * A track has come in, a filter that is too full is made again.
+ * */
+static void track_in(struct members *m, sp_track *track){
+	uintptr_t c = (uintptr_t)ptrmap_get(&m->count, track);
+	if(ptrmap_put(&m->count, track, (void *)(c + 1)))
+		fprintf(stderr, "Out of memory, --unique may let a track in twice.\n");
+	if(m->num * BLOOM_BITS_PER_TRACK > m->bloom_bits)
+		bloom_build(m);
+	else
+		bloom_add(m, track);
+}
+
+
+static void track_out(struct members *m, sp_track *track){
+	uintptr_t c = (uintptr_t)ptrmap_get(&m->count, track);
+	if(c > 1)
+		ptrmap_put(&m->count, track, (void *)(c - 1));
+	else if(c == 1)
+		ptrmap_remove(&m->count, track);
+	m->stale++;
+}
+
+
+static int reserve(struct members *m, int num){
+	if(num <= m->cap)
+		return 0;
+	int cap = m->cap ? m->cap : 16;
+	while(cap < num)
+		cap *= 2;
+	sp_track **t = realloc(m->t, cap * sizeof(*t));
+	if(!t)
+		return -1;
+	m->t = t;
+	m->cap = cap;
+	return 0;
+}
+
+
+/**
+ * Read all tracks of the playlist again.
+ *
+ * @return -1 if it isn't loaded, or we ran out of memory.
+ * */
+static int fill(sp_playlist *pl, struct members *m){
+	int i, n;
+	ptrmap_free(&m->count);
+	ptrmap_init(&m->count);
+	m->num = 0;
+	if(!sp_playlist_is_loaded(pl))
+		return -1;
+	n = sp_playlist_num_tracks(pl);
+	if(reserve(m, n)){
+		fprintf(stderr, "Out of memory, can't tell the tracks of %s.\n", sp_playlist_name(pl));
+		bloom_build(m);
+		return -1;
+	}
+	for(i = 0; i < n; i++){
+		uintptr_t c;
+		m->t[i] = sp_playlist_track(pl, i);
+		c = (uintptr_t)ptrmap_get(&m->count, m->t[i]);
+		ptrmap_put(&m->count, m->t[i], (void *)(c + 1));
+	}
+	m->num = n;
+	return bloom_build(m);
+}
+
+
+/**
+ * If our copy has drifted from the playlist, read it all again.
+ * */
+static void check(sp_playlist *pl, struct members *m){
+	if(m->num != sp_playlist_num_tracks(pl))
+		fill(pl, m);
+}
+
+
+/**
+ * Start using the set of a playlist, making it if there is none, and
+ * keep the callbacks that keep it current until members_close().
+ *
+ * @return -1 if the playlist isn't loaded yet, or we ran out of memory.
+ * */
+int members_open(sp_playlist *pl){
+	struct members *m = ptrmap_get(&by_playlist, pl);
+	if(!m){
+		m = calloc(1, sizeof(*m));
+		if(!m || ptrmap_put(&by_playlist, pl, m)){
+			free(m);
+			fprintf(stderr, "Out of memory, can't tell the tracks of %s.\n", sp_playlist_name(pl));
+			return -1;
+		}
+		ptrmap_init(&m->count);
+		if(fill(pl, m)){
+			members_forget(pl);
+			return -1;
+		}
+	} else {
+		check(pl, m);
+	}
+	playlist_pin(pl);
+	return 0;
+}
+
+
+void members_close(sp_playlist *pl){
+	playlist_unpin(pl);
+}
+
+
+/**
+ * Tell if a track is in a playlist, which must have been opened.
+ * */
+int members_has(sp_playlist *pl, sp_track *track){
+	struct members *m = ptrmap_get(&by_playlist, pl);
+	if(!m || !bloom_maybe(m, track))
+		return 0;
+	return ptrmap_get(&m->count, track) != NULL;
+}
+
+
+/**
+ * Drop the set of a playlist, when its callbacks go.
+ * */
+void members_forget(sp_playlist *pl){
+	struct members *m = ptrmap_remove(&by_playlist, pl);
+	if(!m)
+		return;
+	ptrmap_free(&m->count);
+	free(m->bloom);
+	free(m->t);
+	free(m);
+}
+
+
+void members_playlist_loaded(sp_playlist *pl){
+	struct members *m = ptrmap_get(&by_playlist, pl);
+	if(m)
+		check(pl, m);
+}
+
+
+void members_tracks_added(sp_playlist *pl, sp_track * const *tracks, int n, int position){
+	struct members *m = ptrmap_get(&by_playlist, pl);
+	int i;
+	if(!m)
+		return;
+	if(position < 0 || position > m->num || reserve(m, m->num + n)){
+		fill(pl, m);
+		return;
+	}
+	memmove(m->t + position + n, m->t + position, (m->num - position) * sizeof(*m->t));
+	memcpy(m->t + position, tracks, n * sizeof(*m->t));
+	m->num += n;
+	for(i = 0; i < n; i++)
+		track_in(m, tracks[i]);
+	check(pl, m);
+}
+
+
+void members_tracks_removed(sp_playlist *pl, const int *tracks, int n){
+	struct members *m = ptrmap_get(&by_playlist, pl);
+	int i, j;
+	if(!m || m->num == 0)
+		return;
+	char *gone = calloc(m->num, 1);
+	if(!gone){
+		fill(pl, m);
+		return;
+	}
+	for(i = 0; i < n; i++)
+		if(tracks[i] >= 0 && tracks[i] < m->num)
+			gone[tracks[i]] = 1;
+	for(i = j = 0; i < m->num; i++){
+		if(gone[i])
+			track_out(m, m->t[i]);
+		else
+			m->t[j++] = m->t[i];
+	}
+	m->num = j;
+	free(gone);
+	if(m->stale > m->num && m->stale > BLOOM_MIN_TRACKS)
+		bloom_build(m);
+	check(pl, m);
+}
+
+
+void members_tracks_moved(sp_playlist *pl){
+	struct members *m = ptrmap_get(&by_playlist, pl);
+	if(m)
+		fill(pl, m);
+}
@@ -0,0 +1,15 @@
+#ifndef MEMBERS_H__
+#define MEMBERS_H__
+
+#include <libspotify/api.h>
+
+int members_open(sp_playlist *pl);
+void members_close(sp_playlist *pl);
+int members_has(sp_playlist *pl, sp_track *track);
+void members_forget(sp_playlist *pl);
+void members_playlist_loaded(sp_playlist *pl);
+void members_tracks_added(sp_playlist *pl, sp_track * const *tracks, int n, int position);
+void members_tracks_removed(sp_playlist *pl, const int *tracks, int n);
+void members_tracks_moved(sp_playlist *pl);
+
+#endif
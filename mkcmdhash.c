@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cmdhash.h"
+
+
+/*
+ * Writes cmdtable.h: a seed and a table of slots, making cmd_hash() a
+ * perfect hash of the command names in commands.def. Run when
+ * building, so a new command needs nothing but its line there.
+ * 
+ * */
+
+static const char *names[] = {
+#define CMD(name, fn, needs, args, timeout, help) #name,
+#include "commands.def"
+#undef CMD
+};
+
+#define NUM_NAMES (int)(sizeof(names) / sizeof(names[0]))
+
+/// The tries before the table is made bigger
+#define MAX_SEEDS 1000000
+
+
+int main(void)
+{
+	unsigned int size, seed;
+	int i, j;
+
+	for(i = 0; i < NUM_NAMES; i++) {
+		for(j = 0; j < i; j++) {
+			if(!strcmp(names[i], names[j])) {
+				fprintf(stderr, "mkcmdhash: %s is in commands.def twice\n", names[i]);
+				return 1;
+			}
+		}
+	}
+
+	for(size = 1; size < 2 * NUM_NAMES; size *= 2)
+		;
+	for(;; size *= 2) {
+		int *slots = malloc(size * sizeof(int));
+		if(!slots)
+			return 1;
+		for(seed = 0; seed < MAX_SEEDS; seed++) {
+			for(i = 0; i < (int)size; i++)
+				slots[i] = -1;
+			for(i = 0; i < NUM_NAMES; i++) {
+				unsigned int s = cmd_hash(names[i], seed) & (size - 1);
+				if(slots[s] >= 0)
+					break;
+				slots[s] = i;
+			}
+			if(i < NUM_NAMES)
+				continue;
+
+			printf("/* Made by mkcmdhash from commands.def, don't edit */\n");
+			printf("#define CMD_HASH_SEED %uu\n", seed);
+			printf("#define CMD_HASH_SIZE %u\n", size);
+			printf("static const signed char cmd_slots[CMD_HASH_SIZE] = {");
+			for(i = 0; i < (int)size; i++)
+				printf("%s%d", !i ? "\n\t" : i % 16 ? ", " : ",\n\t", slots[i]);
+			printf("\n};\n");
+			free(slots);
+			return 0;
+		}
+		free(slots);
+	}
+}
@@ -0,0 +1,440 @@
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "listify.h"
+#include "cmd.h"
+#include "link.h"
+#include "ptrmap.h"
+#include "stats.h"
+#include "handle.h"
+#include "arena.h"
+#include "nameindex.h"
+
+
+/*
+ * An index from the trigrams (three letter pieces) of playlist names to
+ * the playlists, so that a playlist can be looked up by a part of its
+ * name or something close to it, as "name:<pattern>" in place of a URI.
+ * 
+ * A lookup counts, for every playlist sharing a trigram with the
+ * pattern, how many it shares, through the postings of the pattern's
+ * trigrams only. Playlists are ranked on the share of their trigrams
+ * and the pattern's that are common, with a bonus for having the
+ * pattern in the name, and a bigger one for being it. Case is ignored.
+ * 
+ * The names are taken as the container tells of playlists, and when
+ * they are renamed. A playlist we have no callbacks on can be renamed
+ * without us knowing, so the names of the best hits are checked before
+ * they are given out, and indexed again if they changed.
+ * 
+ * */
+
+/// The longest name indexed, the rest of it is ignored
+#define NAME_MAX_LEN 255
+
+struct named {
+	sp_playlist *pl;        // NULL if free
+	char *name;             // folded to lower case
+	int num_tri;
+	unsigned int stamp;     // the lookup that last counted it
+	int shared;             // the trigrams it shares with that lookup
+};
+
+struct posting {
+	int num;
+	int cap;
+	int ids[];
+};
+
+static struct named *entries;
+static int num_entries, cap_entries;
+
+/// Free entries, reused before the array grows
+static int *free_ids;
+static int num_free;
+
+/// Entries with no name yet, checked again at each lookup
+static int *unnamed;
+static int num_unnamed, cap_unnamed;
+
+/// sp_playlist* --> id + 1
+static struct ptrmap by_playlist;
+
+/// trigram + 1 --> struct posting*
+static struct ptrmap by_trigram;
+
+static unsigned int stamp;
+
+/// The entries counted in the current lookup
+static int *touched;
+static int cap_touched;
+
+
+/**
+ * Fold a name to lower case, at most NAME_MAX_LEN long.
+ * */
+static void fold(const char *s, char *out){
+	int i;
+	for(i = 0; s[i] && i < NAME_MAX_LEN; i++)
+		out[i] = tolower((unsigned char)s[i]);
+	out[i] = 0;
+}
+
+
+static int tri_cmp(const void *a, const void *b){
+	uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+	return x < y ? -1 : x > y;
+}
+
+
+/**
+ * The distinct trigrams of a folded name, padded with two spaces in
+ * front and one after so that short names and the starts of names
+ * count too.
+ * 
+ * @param out room for NAME_MAX_LEN + 1 trigrams.
+ * 
+ * @return the number of trigrams.
+ * */
+static int trigrams(const char *name, uint32_t *out){
+	int len = strlen(name), i, n = 0;
+	unsigned char padded[NAME_MAX_LEN + 4];
+	padded[0] = padded[1] = ' ';
+	memcpy(padded + 2, name, len);
+	padded[len + 2] = ' ';
+	for(i = 0; i + 2 < len + 3; i++)
+		out[n++] = padded[i] << 16 | padded[i + 1] << 8 | padded[i + 2];
+	qsort(out, n, sizeof(uint32_t), tri_cmp);
+	int d = 0;
+	for(i = 0; i < n; i++)
+		if(!d || out[d - 1] != out[i])
+			out[d++] = out[i];
+	return d;
+}
+
+
+static void *tri_key(uint32_t tri){
+	return (void*)(uintptr_t)(tri + 1);
+}
+
+
+static int posting_add(uint32_t tri, int id){
+	struct posting *p = ptrmap_get(&by_trigram, tri_key(tri));
+	if(!p || p->num == p->cap){
+		int cap = p ? 2 * p->cap : 4;
+		struct posting *bigger = realloc(p, sizeof(struct posting) + cap * sizeof(int));
+		if(!bigger)
+			return -1;
+		if(!p)
+			bigger->num = 0;
+		bigger->cap = cap;
+		if(ptrmap_put(&by_trigram, tri_key(tri), bigger)){
+			// The old one is gone either way, so is this trigram
+			ptrmap_remove(&by_trigram, tri_key(tri));
+			free(bigger);
+			return -1;
+		}
+		p = bigger;
+	}
+	p->ids[p->num++] = id;
+	return 0;
+}
+
+
+static void posting_remove(uint32_t tri, int id){
+	struct posting *p = ptrmap_get(&by_trigram, tri_key(tri));
+	int i;
+	if(!p)
+		return;
+	for(i = 0; i < p->num; i++){
+		if(p->ids[i] == id){
+			p->ids[i] = p->ids[--p->num];
+			break;
+		}
+	}
+	if(!p->num)
+		free(ptrmap_remove(&by_trigram, tri_key(tri)));
+}
+
+
+/**
+ * Index the current name of entry id.
+ * */
+static void index_name(int id){
+	struct named *e = &entries[id];
+	const char *name = sp_playlist_name(e->pl);
+	char folded[NAME_MAX_LEN + 1];
+	uint32_t tri[NAME_MAX_LEN + 1];
+	int i;
+
+	fold(name ? name : "", folded);
+	e->name = strdup(folded);
+	e->num_tri = 0;
+	if(!e->name)
+		return;
+	if(!*folded){
+		// Not loaded yet, look again later
+		if(num_unnamed == cap_unnamed){
+			int cap = cap_unnamed ? 2 * cap_unnamed : 16;
+			int *v = realloc(unnamed, cap * sizeof(int));
+			if(!v)
+				return;
+			unnamed = v;
+			cap_unnamed = cap;
+		}
+		unnamed[num_unnamed++] = id;
+		return;
+	}
+	int n = trigrams(folded, tri);
+	for(i = 0; i < n; i++){
+		if(posting_add(tri[i], id)){
+			fprintf(stderr, "Out of memory, the name index misses %s\n", name);
+			break;
+		}
+	}
+	e->num_tri = i;
+}
+
+
+static void unindex_name(int id){
+	struct named *e = &entries[id];
+	uint32_t tri[NAME_MAX_LEN + 1];
+	int i;
+	if(!e->name)
+		return;
+	if(!*e->name){
+		for(i = 0; i < num_unnamed; i++)
+			if(unnamed[i] == id){
+				unnamed[i] = unnamed[--num_unnamed];
+				break;
+			}
+	}
+	int n = trigrams(e->name, tri);
+	for(i = 0; i < n && i < e->num_tri; i++)
+		posting_remove(tri[i], id);
+	free(e->name);
+	e->name = NULL;
+	e->num_tri = 0;
+}
+
+
+/**
+ * Called when a playlist is added to the container, or seen there
+ * when logging in.
+ * */
+void nameindex_playlist_added(sp_playlist *pl){
+	if(!pl)
+		return;
+	if(ptrmap_get(&by_playlist, pl)){
+		nameindex_playlist_renamed(pl);
+		return;
+	}
+	int id;
+	if(num_free){
+		id = free_ids[--num_free];
+	}else{
+		if(num_entries == cap_entries){
+			int cap = cap_entries ? 2 * cap_entries : 256;
+			struct named *v = realloc(entries, cap * sizeof(struct named));
+			int *f = realloc(free_ids, cap * sizeof(int));
+			if(f)
+				free_ids = f;
+			if(!v || !f){
+				if(v)
+					entries = v;
+				fprintf(stderr, "Out of memory, the name index misses a playlist\n");
+				return;
+			}
+			entries = v;
+			cap_entries = cap;
+		}
+		id = num_entries++;
+	}
+	memset(&entries[id], 0, sizeof(struct named));
+	if(ptrmap_put(&by_playlist, pl, (void*)(intptr_t)(id + 1))){
+		free_ids[num_free++] = id;
+		return;
+	}
+	entries[id].pl = handle_playlist_ref(pl);
+	index_name(id);
+}
+
+
+/**
+ * Called when a playlist got a new name, or when it may have.
+ * */
+void nameindex_playlist_renamed(sp_playlist *pl){
+	int id = (int)(intptr_t)ptrmap_get(&by_playlist, pl) - 1;
+	if(id < 0)
+		return;
+	const char *name = sp_playlist_name(pl);
+	char folded[NAME_MAX_LEN + 1];
+	fold(name ? name : "", folded);
+	if(entries[id].name && !strcmp(folded, entries[id].name))
+		return;
+	unindex_name(id);
+	index_name(id);
+}
+
+
+/**
+ * Called when a playlist is removed from the container.
+ * */
+void nameindex_playlist_removed(sp_playlist *pl){
+	int id = (int)(intptr_t)ptrmap_remove(&by_playlist, pl) - 1;
+	if(id < 0)
+		return;
+	unindex_name(id);
+	handle_playlist_release(&entries[id].pl);
+	free_ids[num_free++] = id;
+}
+
+
+/**
+ * Count the trigrams each entry shares with the pattern.
+ * 
+ * @return the number of entries touched, -1 if out of memory.
+ * */
+static int count_shared(const uint32_t *tri, int n){
+	int i, j, num = 0;
+	stamp++;
+	for(i = 0; i < n; i++){
+		struct posting *p = ptrmap_get(&by_trigram, tri_key(tri[i]));
+		if(!p)
+			continue;
+		for(j = 0; j < p->num; j++){
+			struct named *e = &entries[p->ids[j]];
+			if(e->stamp != stamp){
+				if(num == cap_touched){
+					int cap = cap_touched ? 2 * cap_touched : 256;
+					int *v = realloc(touched, cap * sizeof(int));
+					if(!v)
+						return -1;
+					touched = v;
+					cap_touched = cap;
+				}
+				touched[num++] = p->ids[j];
+				e->stamp = stamp;
+				e->shared = 0;
+			}
+			e->shared++;
+		}
+	}
+	return num;
+}
+
+
+static int rank(const char *pattern, int q, int n, struct name_hit *hits, int max){
+	int i, j, num = 0;
+	for(i = 0; i < n; i++){
+		struct named *e = &entries[touched[i]];
+		double score = (double)e->shared / (q + e->num_tri - e->shared);
+		if(!strcmp(e->name, pattern))
+			score += 2;
+		else if(strstr(e->name, pattern))
+			score += 1;
+		if(num == max && score <= hits[num - 1].score)
+			continue;
+		if(num < max)
+			num++;
+		for(j = num - 1; j > 0 && hits[j - 1].score < score; j--)
+			hits[j] = hits[j - 1];
+		hits[j].pl = e->pl;
+		hits[j].score = score;
+	}
+	return num;
+}
+
+
+/**
+ * Find the playlists with names most like the pattern, best first.
+ * 
+ * @param pattern with _ for spaces, as on the command line.
+ * 
+ * @return the number of hits, at most max.
+ * */
+int nameindex_lookup(const char *pattern, struct name_hit *hits, int max){
+	char folded[NAME_MAX_LEN + 1];
+	uint32_t tri[NAME_MAX_LEN + 1];
+	int i, n, num, tries;
+	char *cp;
+
+	fold(pattern, folded);
+	for(cp = folded; *cp; cp++)
+		if(*cp == '_')
+			*cp = ' ';
+	int q = trigrams(folded, tri);
+
+	// Those that had no name may have one now
+	for(i = num_unnamed - 1; i >= 0; i--){
+		int id = unnamed[i];
+		const char *name = sp_playlist_name(entries[id].pl);
+		if(name && *name)
+			nameindex_playlist_renamed(entries[id].pl);
+	}
+
+	for(tries = 0; ; tries++){
+		n = count_shared(tri, q);
+		if(n < 0)
+			return 0;
+		num = rank(folded, q, n, hits, max);
+		// Make sure the names of the hits are still right
+		int stale = 0;
+		for(i = 0; i < num; i++){
+			int id = (int)(intptr_t)ptrmap_get(&by_playlist, hits[i].pl) - 1;
+			char now[NAME_MAX_LEN + 1];
+			const char *name = sp_playlist_name(hits[i].pl);
+			fold(name ? name : "", now);
+			if(strcmp(now, entries[id].name)){
+				nameindex_playlist_renamed(hits[i].pl);
+				stale = 1;
+			}
+		}
+		if(!stale || tries == 2)
+			return num;
+	}
+}
+
+
+/**
+ * The URI of the best match of the pattern.
+ * 
+ * @return the URI, in the arena of the command. NULL if nothing matched.
+ * */
+char *nameindex_resolve(const char *pattern){
+	struct name_hit hit;
+	char buff[256];
+	if(nameindex_lookup(pattern, &hit, 1) < 1){
+		fprintf(stderr, "No playlist has a name like %s\n", pattern);
+		return NULL;
+	}
+	if(!playlist_to_URI(hit.pl, buff, sizeof(buff)))
+		return NULL;
+	printf("name:%s is %s\n", pattern, sp_playlist_name(hit.pl));
+	return arena_strdup(buff);
+}
+
+
+/**
+ * List the playlists with names most like the pattern.
+ * 
+ * @param 1
+ * The pattern, with _ for spaces.
+ * 
+ * @return -1.
+ * */
+int cmd_find_playlist(int argc, char **argv){
+	struct name_hit hits[NAMEINDEX_MAX_HITS];
+	uint64_t t0 = stats_now_usec();
+	int i, n = nameindex_lookup(argv[1], hits, NAMEINDEX_MAX_HITS);
+	uint64_t t1 = stats_now_usec();
+	for(i = 0; i < n; i++){
+		char buff[256];
+		playlist_to_URI(hits[i].pl, buff, sizeof(buff));
+		printf("  %5.2f  %-30s %s\n", hits[i].score, sp_playlist_name(hits[i].pl), buff);
+	}
+	printf("%d hits of %d playlists, found in %u us.\n", n, num_entries - num_free, (unsigned int)(t1 - t0));
+	return -1;
+}
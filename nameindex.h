@@ -0,0 +1,20 @@
+#ifndef NAMEINDEX_H__
+#define NAMEINDEX_H__
+
+#include <libspotify/api.h>
+
+/* The most matches a lookup ranks */
+#define NAMEINDEX_MAX_HITS 10
+
+struct name_hit {
+	sp_playlist *pl;
+	double score;
+};
+
+void nameindex_playlist_added(sp_playlist *pl);
+void nameindex_playlist_renamed(sp_playlist *pl);
+void nameindex_playlist_removed(sp_playlist *pl);
+int nameindex_lookup(const char *pattern, struct name_hit *hits, int max);
+char *nameindex_resolve(const char *pattern);
+
+#endif
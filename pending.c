@@ -0,0 +1,239 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "listify.h"
+#include "cmd.h"
+#include "list.h"
+#include "ptrmap.h"
+#include "timer.h"
+#include "pending.h"
+
+
+/*
+ * The changes we have made to playlists that the server doesn't have
+ * yet. libspotify queues them and sends them in the background, so a
+ * bulk command is done long before its tracks are synced, and logging
+ * out or exiting then would lose them.
+ *
+ * Each change we make is counted against its playlist, and the
+ * playlist is pinned, so that its callbacks keep coming. Its count is
+ * dropped when sp_playlist_has_pending_changes() says it is all sent,
+ * which is looked at when libspotify tells of a change of state or of
+ * an update, and every PENDING_POLL_MS as long as anything is left,
+ * in case it tells of neither.
+ *
+ * When PENDING_HIGH_WATER changes are waiting, the commands that
+ * make more (those that need NEED_ROOM) are queued, until no more
+ * than PENDING_LOW_WATER are left, see cmd_dispatch(). So the queue
+ * of libspotify can't grow without bound, however fast the commands
+ * come.
+ *
+ * When the last change is synced the waiters are called, for "sync"
+ * and for logout, see cmd_logout().
+ *
+ * */
+
+/// sp_playlist* --> how many changes it has waiting, as a uintptr_t
+static struct ptrmap playlists;
+static int num_playlists;
+static int num_changes;
+static int full;
+
+static struct pending_waiter *waiters;
+static struct timer poll_timer;
+
+/// The waiter of the running sync command, and its token
+static struct pending_waiter sync_waiter;
+static unsigned int sync_token;
+
+
+/**
+ * Nothing is waiting to be synced, call the waiters. Each may add
+ * another, which is left for the next time.
+ * */
+static void all_synced(void){
+	struct pending_waiter *list = waiters;
+	timer_cancel(&poll_timer);
+	waiters = NULL;
+	if(list)
+		list->pprev = &list;
+	while(list){
+		struct pending_waiter *w = list;
+		list = w->next;
+		if(list)
+			list->pprev = &list;
+		w->next = NULL;
+		w->pprev = NULL;
+		w->fn(w);
+	}
+}
+
+
+/**
+ * The playlist is synced, or we can't tell any more.
+ * */
+static void drop(sp_playlist *pl){
+	uintptr_t n = (uintptr_t)ptrmap_remove(&playlists, pl);
+	if(!n)
+		return;
+	num_changes -= n;
+	num_playlists--;
+	if(full && num_changes <= PENDING_LOW_WATER)
+		full = 0;
+	playlist_unpin(pl);
+	if(!num_playlists)
+		all_synced();
+}
+
+
+/**
+ * Look at all playlists with changes, some may be synced without our
+ * having been told.
+ * */
+static void poll_playlists(struct timer *t){
+	sp_playlist *synced[64];
+	unsigned int iter = 0;
+	void *key, *val;
+	int i, n = 0;
+	while(n < 64 && ptrmap_next(&playlists, &iter, &key, &val))
+		if(!sp_playlist_has_pending_changes(key))
+			synced[n++] = key;
+	for(i = 0; i < n; i++)
+		drop(synced[i]);
+	if(num_playlists)
+		timer_add(&poll_timer, &poll_playlists, n == 64 ? 0 : PENDING_POLL_MS);
+}
+
+
+/**
+ * Count changes we have just made to a playlist, n tracks added or
+ * removed.
+ * */
+void pending_changed(sp_playlist *pl, int n){
+	uintptr_t had = (uintptr_t)ptrmap_get(&playlists, pl);
+	if(n < 1)
+		n = 1;
+	if(ptrmap_put(&playlists, pl, (void *)(had + n))){
+		fprintf(stderr, "Out of memory, can't tell when %s is synced.\n", sp_playlist_name(pl));
+		return;
+	}
+	if(!had){
+		playlist_pin(pl);
+		num_playlists++;
+	}
+	num_changes += n;
+	if(num_changes >= PENDING_HIGH_WATER)
+		full = 1;
+	if(!timer_pending(&poll_timer))
+		timer_add(&poll_timer, &poll_playlists, PENDING_POLL_MS);
+}
+
+
+/**
+ * libspotify told of something that may mean the playlist is synced.
+ * */
+void pending_check(sp_playlist *pl){
+	if(ptrmap_get(&playlists, pl) && !sp_playlist_has_pending_changes(pl))
+		drop(pl);
+}
+
+
+/**
+ * Stop counting the changes of a playlist, when we lose its callbacks.
+ * Its pin is gone with them.
+ * */
+void pending_forget(sp_playlist *pl){
+	drop(pl);
+}
+
+
+/**
+ * @return how many changes are waiting to be synced.
+ * */
+int pending_changes(void){
+	return num_changes;
+}
+
+
+/**
+ * @return how many playlists have changes waiting.
+ * */
+int pending_playlists(void){
+	return num_playlists;
+}
+
+
+/**
+ * Tell if the commands that make changes should wait.
+ * */
+int pending_full(void){
+	return full;
+}
+
+
+/**
+ * Call fn(w) when nothing is waiting to be synced, which may be right
+ * away. If w is waiting already it's left as it is.
+ * */
+void pending_wait(struct pending_waiter *w, pending_fn *fn){
+	if(pending_waiting(w))
+		return;
+	w->fn = fn;
+	if(!num_playlists){
+		fn(w);
+		return;
+	}
+	w->next = waiters;
+	if(waiters)
+		waiters->pprev = &w->next;
+	w->pprev = &waiters;
+	waiters = w;
+}
+
+
+void pending_cancel(struct pending_waiter *w){
+	if(!w->pprev)
+		return;
+	*w->pprev = w->next;
+	if(w->next)
+		w->next->pprev = w->pprev;
+	w->next = NULL;
+	w->pprev = NULL;
+}
+
+
+int pending_waiting(const struct pending_waiter *w){
+	return w->pprev != NULL;
+}
+
+
+static void sync_done(struct pending_waiter *w){
+	if(!cmd_waiting(sync_token))
+		return;
+	printf("All changes are synced.\n");
+	fflush(stdout);
+	cmd_complete(sync_token);
+}
+
+
+static void sync_cancel(void *data){
+	pending_cancel(&sync_waiter);
+}
+
+
+/**
+ * Wait until all changes we have made are synced.
+ * */
+int cmd_sync(int argc, char **argv){
+	if(!num_playlists){
+		printf("All changes are synced.\n");
+		return -1;
+	}
+	printf("Waiting for %d changes to %d playlists to be synced.\n",
+	       num_changes, num_playlists);
+	fflush(stdout);
+	sync_token = cmd_token();
+	pending_wait(&sync_waiter, &sync_done);
+	cmd_on_cancel(&sync_cancel, NULL);
+	return 0;
+}
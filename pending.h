@@ -0,0 +1,39 @@
+#ifndef PENDING_H__
+#define PENDING_H__
+
+#include <libspotify/api.h>
+
+/* Changes waiting to be synced from which commands that make more wait */
+#define PENDING_HIGH_WATER 20000
+
+/* ... until there are no more than this */
+#define PENDING_LOW_WATER 10000
+
+/* How often the playlists with changes are looked at, in case no callback tells */
+#define PENDING_POLL_MS 1000
+
+struct pending_waiter;
+typedef void pending_fn(struct pending_waiter *w);
+
+/*
+ * Something waiting for all changes to be synced, to be embedded in
+ * whatever it's for. It's waiting from pending_wait() until it has
+ * been called or cancelled.
+ */
+struct pending_waiter {
+	struct pending_waiter *next;
+	struct pending_waiter **pprev;
+	pending_fn *fn;
+};
+
+void pending_changed(sp_playlist *pl, int n);
+void pending_check(sp_playlist *pl);
+void pending_forget(sp_playlist *pl);
+int pending_changes(void);
+int pending_playlists(void);
+int pending_full(void);
+void pending_wait(struct pending_waiter *w, pending_fn *fn);
+void pending_cancel(struct pending_waiter *w);
+int pending_waiting(const struct pending_waiter *w);
+
+#endif
@@ -0,0 +1,224 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "listify.h"
+#include "pool.h"
+
+
+/*
+ * A small pool of worker threads for the CPU work of commands, so that
+ * it doesn't hold up sp_session_process_events(). libspotify is only
+ * ever called from the main thread, so a task is split in two: the
+ * work, which runs on any worker, and the completion, which is queued
+ * back to the main thread and run from its loop. notify_work_done()
+ * wakes the main loop when there are completions, just as
+ * notify_main_thread() does for libspotify events.
+ * 
+ * Every worker has a deque of tasks. It takes from its own back, so
+ * that work submitted from work is done depth first, and when it has
+ * none it steals from the front of the others. Tasks from the main
+ * thread are dealt out round robin.
+ * 
+ * The threads are started on the first pool_submit().
+ * 
+ * */
+
+struct task {
+	struct task *prev, *next;
+	pool_work_fn *work;
+	pool_done_fn *done;
+	void *arg;
+};
+
+struct deque {
+	pthread_mutex_t mutex;
+	struct task *front, *back;
+};
+
+static int num_workers;
+static struct deque deques[POOL_MAX_THREADS];
+
+/// The deque of the current thread, -1 on threads not in the pool
+static __thread int my_deque = -1;
+
+/// Where the next task from outside the pool goes
+static int next_deque;
+
+/// Protects num_queued and wakes the idle workers. A worker takes one
+/// off num_queued before it looks for the task, so there's always one.
+static pthread_mutex_t idle_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+static int num_queued;
+
+/// The tasks whose work is done, in the order they got done
+static pthread_mutex_t done_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct task *done_first, **done_last = &done_first;
+
+
+static void deque_push_back(struct deque *d, struct task *t){
+	pthread_mutex_lock(&d->mutex);
+	t->next = NULL;
+	t->prev = d->back;
+	if(d->back)
+		d->back->next = t;
+	else
+		d->front = t;
+	d->back = t;
+	pthread_mutex_unlock(&d->mutex);
+}
+
+
+static struct task *deque_pop_back(struct deque *d){
+	pthread_mutex_lock(&d->mutex);
+	struct task *t = d->back;
+	if(t){
+		d->back = t->prev;
+		if(d->back)
+			d->back->next = NULL;
+		else
+			d->front = NULL;
+	}
+	pthread_mutex_unlock(&d->mutex);
+	return t;
+}
+
+
+static struct task *deque_pop_front(struct deque *d){
+	pthread_mutex_lock(&d->mutex);
+	struct task *t = d->front;
+	if(t){
+		d->front = t->next;
+		if(d->front)
+			d->front->prev = NULL;
+		else
+			d->back = NULL;
+	}
+	pthread_mutex_unlock(&d->mutex);
+	return t;
+}
+
+
+/**
+ * Take a task, from our own deque if it has one, else from another's.
+ * */
+static struct task *take_task(int self){
+	struct task *t = deque_pop_back(&deques[self]);
+	int i;
+	for(i = 1; !t && i < num_workers; i++)
+		t = deque_pop_front(&deques[(self + i) % num_workers]);
+	return t;
+}
+
+
+static void *worker(void *aux){
+	int self = (int)(long)aux;
+	my_deque = self;
+
+	for(;;){
+		pthread_mutex_lock(&idle_mutex);
+		while(num_queued == 0)
+			pthread_cond_wait(&idle_cond, &idle_mutex);
+		num_queued--;
+		pthread_mutex_unlock(&idle_mutex);
+
+		struct task *t;
+		while(!(t = take_task(self)))
+			;
+
+		t->work(t->arg);
+
+		pthread_mutex_lock(&done_mutex);
+		t->next = NULL;
+		*done_last = t;
+		done_last = &t->next;
+		pthread_mutex_unlock(&done_mutex);
+		notify_work_done();
+	}
+	return NULL;
+}
+
+
+/**
+ * Start the workers, one per core.
+ * 
+ * @return -1 if not even one could be started.
+ * */
+static int pool_start(void){
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	int i, started = 0;
+	if(cores < 1)
+		cores = 1;
+	if(cores > POOL_MAX_THREADS)
+		cores = POOL_MAX_THREADS;
+
+	// The deque of a worker that failed to start is still stolen from
+	num_workers = cores;
+	for(i = 0; i < cores; i++)
+		pthread_mutex_init(&deques[i].mutex, NULL);
+	for(i = 0; i < cores; i++){
+		pthread_t id;
+		if(pthread_create(&id, NULL, worker, (void*)(long)i))
+			continue;
+		pthread_detach(id);
+		started++;
+	}
+	if(!started){
+		num_workers = 0;
+		fprintf(stderr, "Couldn't start any worker thread.\n");
+		return -1;
+	}
+	return 0;
+}
+
+
+/**
+ * Have work(arg) run on a worker thread, and then done(arg) on the
+ * main thread. May be called from work, too.
+ * 
+ * @return -1 if the task couldn't be queued, then nothing is run.
+ * */
+int pool_submit(pool_work_fn *work, pool_done_fn *done, void *arg){
+	if(!num_workers && pool_start())
+		return -1;
+	struct task *t = malloc(sizeof(struct task));
+	if(!t)
+		return -1;
+	t->work = work;
+	t->done = done;
+	t->arg = arg;
+
+	int d = my_deque;
+	if(d < 0){
+		d = next_deque;
+		next_deque = (next_deque + 1) % num_workers;
+	}
+	deque_push_back(&deques[d], t);
+
+	pthread_mutex_lock(&idle_mutex);
+	num_queued++;
+	pthread_cond_signal(&idle_cond);
+	pthread_mutex_unlock(&idle_mutex);
+	return 0;
+}
+
+
+/**
+ * Run the completions of the tasks that are done. Called by the main
+ * loop when woken by notify_work_done().
+ * */
+void pool_run_completions(void){
+	pthread_mutex_lock(&done_mutex);
+	struct task *t = done_first;
+	done_first = NULL;
+	done_last = &done_first;
+	pthread_mutex_unlock(&done_mutex);
+
+	while(t){
+		struct task *next = t->next;
+		if(t->done)
+			t->done(t->arg);
+		free(t);
+		t = next;
+	}
+}
@@ -0,0 +1,16 @@
+#ifndef POOL_H__
+#define POOL_H__
+
+/* The most worker threads, whatever the number of cores */
+#define POOL_MAX_THREADS 16
+
+/* Runs on a worker thread, must not call libspotify */
+typedef void pool_work_fn(void *arg);
+
+/* Runs on the main thread once the work is done */
+typedef void pool_done_fn(void *arg);
+
+int pool_submit(pool_work_fn *work, pool_done_fn *done, void *arg);
+void pool_run_completions(void);
+
+#endif
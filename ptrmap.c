@@ -0,0 +1,148 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "ptrmap.h"
+
+
+/*
+ * Open addressing with linear probing. Removal shifts the following
+ * entries back, so there are no tombstones and lookups stay short.
+ * 
+ * */
+
+
+static unsigned int slot_of(const struct ptrmap *m, const void *key){
+	uint64_t h = (uint64_t)(uintptr_t)key;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return (unsigned int)h & (m->cap - 1);
+}
+
+
+void ptrmap_init(struct ptrmap *m){
+	m->keys = NULL;
+	m->vals = NULL;
+	m->cap = 0;
+	m->num = 0;
+}
+
+
+void ptrmap_free(struct ptrmap *m){
+	free(m->keys);
+	free(m->vals);
+	ptrmap_init(m);
+}
+
+
+void *ptrmap_get(const struct ptrmap *m, const void *key){
+	if(!m->cap)
+		return NULL;
+	unsigned int i = slot_of(m, key);
+	while(m->keys[i]){
+		if(m->keys[i] == key)
+			return m->vals[i];
+		i = (i + 1) & (m->cap - 1);
+	}
+	return NULL;
+}
+
+
+static int grow(struct ptrmap *m){
+	unsigned int cap = m->cap ? m->cap * 2 : 16;
+	struct ptrmap bigger = {
+		calloc(cap, sizeof(void*)),
+		calloc(cap, sizeof(void*)),
+		cap,
+		0
+	};
+	if(!bigger.keys || !bigger.vals){
+		free(bigger.keys);
+		free(bigger.vals);
+		return -1;
+	}
+	unsigned int i;
+	for(i = 0; i < m->cap; i++)
+		if(m->keys[i])
+			ptrmap_put(&bigger, m->keys[i], m->vals[i]);
+	free(m->keys);
+	free(m->vals);
+	*m = bigger;
+	return 0;
+}
+
+
+/**
+ * Map key to val, replacing what key mapped to before.
+ * 
+ * @return -1 if out of memory. 0 otherwise.
+ * */
+int ptrmap_put(struct ptrmap *m, void *key, void *val){
+	if((m->num + 1) * 4 > m->cap * 3 && grow(m))
+		return -1;
+	unsigned int i = slot_of(m, key);
+	while(m->keys[i]){
+		if(m->keys[i] == key){
+			m->vals[i] = val;
+			return 0;
+		}
+		i = (i + 1) & (m->cap - 1);
+	}
+	m->keys[i] = key;
+	m->vals[i] = val;
+	m->num++;
+	return 0;
+}
+
+
+/**
+ * Remove key from the map.
+ * 
+ * @return what key mapped to, NULL if it wasn't there.
+ * */
+void *ptrmap_remove(struct ptrmap *m, const void *key){
+	if(!m->cap)
+		return NULL;
+	unsigned int mask = m->cap - 1;
+	unsigned int i = slot_of(m, key);
+	while(m->keys[i] != key){
+		if(!m->keys[i])
+			return NULL;
+		i = (i + 1) & mask;
+	}
+	void *val = m->vals[i];
+	m->num--;
+
+	// Move back the entries that would have been in slot i
+	unsigned int j = i;
+	while(1){
+		m->keys[i] = NULL;
+		m->vals[i] = NULL;
+		do {
+			j = (j + 1) & mask;
+			if(!m->keys[j])
+				return val;
+		} while(((j - slot_of(m, m->keys[j])) & mask) < ((j - i) & mask));
+		m->keys[i] = m->keys[j];
+		m->vals[i] = m->vals[j];
+		i = j;
+	}
+}
+
+
+/**
+ * Walk through the map. Start with *iter = 0, and call until 0 is
+ * returned. The map must not be changed during the walk.
+ * 
+ * @return 1 if *key and *val were set, 0 at the end.
+ * */
+int ptrmap_next(const struct ptrmap *m, unsigned int *iter, void **key, void **val){
+	while(*iter < m->cap){
+		unsigned int i = (*iter)++;
+		if(m->keys[i]){
+			*key = m->keys[i];
+			*val = m->vals[i];
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,23 @@
+#ifndef PTRMAP_H__
+#define PTRMAP_H__
+
+/*
+ * A hash map from pointers to pointers. libspotify gives out one
+ * handle per track, playlist, album etc., so the handles themselves
+ * make good keys. NULL can be neither key nor value.
+ */
+struct ptrmap {
+	void **keys;
+	void **vals;
+	unsigned int cap;
+	unsigned int num;
+};
+
+void ptrmap_init(struct ptrmap *m);
+void ptrmap_free(struct ptrmap *m);
+void *ptrmap_get(const struct ptrmap *m, const void *key);
+int ptrmap_put(struct ptrmap *m, void *key, void *val);
+void *ptrmap_remove(struct ptrmap *m, const void *key);
+int ptrmap_next(const struct ptrmap *m, unsigned int *iter, void **key, void **val);
+
+#endif
@@ -0,0 +1,483 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "listify.h"
+#include "list.h"
+#include "stats.h"
+#include "cblog.h"
+#include "fakespotify.h"
+#include "replay.h"
+
+
+/*
+ * Feeds a callback log of "listify --record" (see cblog.c) back to the
+ * callbacks of listify, through the libspotify stand-in: each record
+ * first makes the stand-in look like it did then, and then the
+ * callbacks are given just as they were logged. The main loop of
+ * loadgen calls replay_run_due() as it would call libspotify.
+ *
+ * The records come at the times they were logged, divided by the
+ * speed, or as fast as they can if the speed is 0. How long the
+ * callbacks take is measured for each type, and how late they came,
+ * which is what the main loop costs.
+ *
+ * A playlist is pinned once it has a playlist callback, so that ours
+ * are added to it. The replay ends at logged_out, which would exit.
+ *
+ * */
+
+struct type_stats {
+	unsigned int count;
+	uint64_t total;
+	uint64_t max;
+};
+
+static unsigned char *data;
+static const unsigned char *cur;
+static const unsigned char *end;
+static int bad;
+static int finished;
+
+static double speed;
+static uint64_t start_time;
+static uint64_t next_at;      // usec from the start, recorded time
+
+/// The playlists and tracks of the log, by their number less one
+static sp_playlist **playlists;
+static char *pinned;
+static int num_playlists;
+static sp_track **tracks;
+static int num_tracks;
+
+static struct type_stats stats[CBLOG_NUM_TYPES];
+static uint64_t *lags;
+static unsigned int num_lags;
+static unsigned int num_records;
+
+
+/* ----------------------------  READING  ---------------------------------- */
+
+static uint64_t get_varint(void){
+	uint64_t v = 0;
+	int shift = 0;
+	while(cur < end && shift < 64){
+		unsigned char b = *cur++;
+		v |= (uint64_t)(b & 0x7f) << shift;
+		if(!(b & 0x80))
+			return v;
+		shift += 7;
+	}
+	bad = 1;
+	return 0;
+}
+
+
+/**
+ * @return the string, free it. NULL if the log is bad.
+ * */
+static char *get_string(void){
+	uint64_t n = get_varint();
+	if(bad || n > (uint64_t)(end - cur)){
+		bad = 1;
+		return NULL;
+	}
+	char *s = malloc(n + 1);
+	if(!s){
+		bad = 1;
+		return NULL;
+	}
+	memcpy(s, cur, n);
+	s[n] = 0;
+	cur += n;
+	return s;
+}
+
+
+/**
+ * Make room for one more, the arrays go 16, 32, 64 ...
+ * */
+static void *grow(void *v, int num, size_t size){
+	if(num && (num < 16 || (num & (num - 1))))
+		return v;
+	v = realloc(v, (num ? 2 * num : 16) * size);
+	if(!v){
+		fprintf(stderr, "replay: out of memory\n");
+		exit(1);
+	}
+	return v;
+}
+
+
+/**
+ * @param idx gets its number less one, may be NULL.
+ * */
+static sp_playlist *get_playlist(int *idx){
+	uint64_t id = get_varint();
+	if(!id || bad)
+		return NULL;
+	if(idx)
+		*idx = id - 1;
+	if(id <= num_playlists)
+		return playlists[id - 1];
+	if(id != num_playlists + 1){
+		bad = 1;
+		return NULL;
+	}
+	char *uri = get_string();
+	char *name = get_string();
+	sp_playlist *pl = uri && name ? fake_playlist(uri, name) : NULL;
+	free(uri);
+	free(name);
+	playlists = grow(playlists, num_playlists, sizeof(*playlists));
+	pinned = grow(pinned, num_playlists, 1);
+	playlists[num_playlists] = pl;
+	pinned[num_playlists++] = 0;
+	return pl;
+}
+
+
+static sp_track *get_track(void){
+	uint64_t id = get_varint();
+	if(!id || bad)
+		return NULL;
+	if(id <= num_tracks)
+		return tracks[id - 1];
+	if(id != num_tracks + 1){
+		bad = 1;
+		return NULL;
+	}
+	char *uri = get_string();
+	sp_track *track = uri ? fake_track(uri) : NULL;
+	free(uri);
+	tracks = grow(tracks, num_tracks, sizeof(*tracks));
+	tracks[num_tracks++] = track;
+	return track;
+}
+
+
+/**
+ * n tracks, or indices if as_int. NULL tracks are left out.
+ *
+ * @return the array, free it. *n gets how many there are.
+ * */
+static void *get_list(int *n, int as_int){
+	uint64_t num = get_varint();
+	int i, j;
+	if(bad || num > (uint64_t)(end - cur)){
+		bad = 1;
+		return NULL;
+	}
+	void *v = malloc((num ? num : 1) * (as_int ? sizeof(int) : sizeof(sp_track *)));
+	if(!v){
+		bad = 1;
+		return NULL;
+	}
+	for(i = j = 0; i < num; i++){
+		if(as_int){
+			((int *)v)[j++] = get_varint();
+		} else {
+			sp_track *track = get_track();
+			if(track)
+				((sp_track **)v)[j++] = track;
+		}
+	}
+	*n = j;
+	return v;
+}
+
+
+static void get_container(void){
+	uint64_t n = get_varint();
+	int i, j;
+	if(bad || n > (uint64_t)(end - cur)){
+		bad = 1;
+		return;
+	}
+	sp_playlist **v = malloc((n ? n : 1) * sizeof(*v));
+	if(!v){
+		bad = 1;
+		return;
+	}
+	for(i = j = 0; i < n; i++){
+		sp_playlist *pl = get_playlist(NULL);
+		if(pl)
+			v[j++] = pl;
+	}
+	fake_set_container(g_session, v, j);
+	free(v);
+}
+
+
+/**
+ * Have our playlist callbacks on playlist i, which the log says we had.
+ * */
+static void pin(int i){
+	if(playlists[i] && !pinned[i]){
+		pinned[i] = 1;
+		playlist_pin(playlists[i]);
+	}
+}
+
+
+/* ----------------------------  REPLAYING  -------------------------------- */
+
+/**
+ * Read a log, to replay it at the given speed.
+ *
+ * @return -1 if it can't be read. 0 otherwise.
+ * */
+int replay_open(const char *path, double s){
+	FILE *f = fopen(path, "rb");
+	long size;
+	if(!f){
+		fprintf(stderr, "Can't read the callback log %s\n", path);
+		return -1;
+	}
+	if(fseek(f, 0, SEEK_END) || (size = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) ||
+	   !(data = malloc(size ? size : 1)) || fread(data, 1, size, f) != size){
+		fprintf(stderr, "Can't read the callback log %s\n", path);
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+	if(size < strlen(CBLOG_MAGIC) || memcmp(data, CBLOG_MAGIC, strlen(CBLOG_MAGIC))){
+		fprintf(stderr, "%s isn't a callback log\n", path);
+		return -1;
+	}
+	cur = data + strlen(CBLOG_MAGIC);
+	end = data + size;
+	speed = s;
+	fake_hold_events();
+	return 0;
+}
+
+
+/**
+ * Give the next record to the callbacks.
+ * */
+static void replay_one(void){
+	const sp_session_callbacks *cb = fake_session_callbacks(g_session);
+	int type = *cur++;
+	sp_playlist *pl = NULL;
+	sp_track **tv = NULL;
+	int *iv = NULL;
+	char *s = NULL;
+	int n = 0, a = 0, b = 0, idx = -1;
+	uint64_t t;
+
+	next_at += get_varint();
+	if(type <= 0 || type >= CBLOG_NUM_TYPES){
+		bad = 1;
+		return;
+	}
+	// Read it all, and set up the stand-in, before the clock starts
+	switch(type){
+	case CBLOG_LOGGED_IN:
+		a = get_varint();
+		if(a == SP_ERROR_OK)
+			fake_log_in(g_session);
+		get_container();
+		break;
+	case CBLOG_CONNECTION_ERROR:
+		a = get_varint();
+		break;
+	case CBLOG_LOG_MESSAGE:
+		s = get_string();
+		break;
+	case CBLOG_PLAYLIST_ADDED:
+	case CBLOG_PLAYLIST_REMOVED:
+		pl = get_playlist(&idx);
+		a = get_varint();
+		break;
+	case CBLOG_CONTAINER_LOADED:
+		get_container();
+		break;
+	case CBLOG_TRACKS_ADDED:
+		pl = get_playlist(&idx);
+		a = get_varint();
+		tv = get_list(&n, 0);
+		break;
+	case CBLOG_TRACKS_REMOVED:
+		pl = get_playlist(&idx);
+		iv = get_list(&n, 1);
+		break;
+	case CBLOG_TRACKS_MOVED:
+		pl = get_playlist(&idx);
+		a = get_varint();
+		iv = get_list(&n, 1);
+		break;
+	case CBLOG_PLAYLIST_RENAMED:
+		pl = get_playlist(&idx);
+		s = get_string();
+		break;
+	case CBLOG_PLAYLIST_STATE_CHANGED:
+		pl = get_playlist(&idx);
+		b = get_varint();
+		if(b)
+			tv = get_list(&n, 0);
+		if(pl && b)
+			fake_set_tracks(pl, tv, n);
+		break;
+	case CBLOG_PLAYLIST_UPDATE_IN_PROGRESS:
+		pl = get_playlist(&idx);
+		b = get_varint();
+		break;
+	default:
+		break;
+	}
+	if(bad || type == CBLOG_LOGGED_OUT || (type == CBLOG_LOGGED_IN && a != SP_ERROR_OK)){
+		finished = 1;
+		goto out;
+	}
+	// The recorder was out of memory, or the URI was bad
+	if(type >= CBLOG_PLAYLIST_ADDED && type != CBLOG_CONTAINER_LOADED && !pl)
+		goto out;
+	if(type >= CBLOG_TRACKS_ADDED)
+		pin(idx);
+
+	t = stats_now_usec();
+	if(speed > 0){
+		uint64_t due = start_time + (uint64_t)(next_at / speed);
+		lags = grow(lags, num_lags, sizeof(*lags));
+		lags[num_lags++] = t > due ? t - due : 0;
+	}
+	switch(type){
+	case CBLOG_LOGGED_IN:
+		cb->logged_in(g_session, a);
+		break;
+	case CBLOG_METADATA_UPDATED:
+		cb->metadata_updated(g_session);
+		break;
+	case CBLOG_CONNECTION_ERROR:
+		cb->connection_error(g_session, a);
+		break;
+	case CBLOG_LOG_MESSAGE:
+		cb->log_message(g_session, s ? s : "");
+		break;
+	case CBLOG_NOTIFY_MAIN_THREAD:
+		cb->notify_main_thread(g_session);
+		break;
+	case CBLOG_PLAYLIST_ADDED:
+		fake_playlist_added(g_session, pl, a);
+		break;
+	case CBLOG_PLAYLIST_REMOVED:
+		fake_playlist_removed(g_session, pl, a);
+		break;
+	case CBLOG_CONTAINER_LOADED:
+		fake_container_loaded(g_session);
+		break;
+	case CBLOG_TRACKS_ADDED:
+		fake_tracks_added(pl, tv, n, a);
+		break;
+	case CBLOG_TRACKS_REMOVED:
+		fake_tracks_removed(pl, iv, n);
+		break;
+	case CBLOG_TRACKS_MOVED:
+		fake_tracks_moved(pl, iv, n, a);
+		break;
+	case CBLOG_PLAYLIST_RENAMED:
+		fake_playlist_renamed(pl, s ? s : "");
+		break;
+	case CBLOG_PLAYLIST_STATE_CHANGED:
+		fake_playlist_state_changed(pl, b);
+		break;
+	case CBLOG_PLAYLIST_UPDATE_IN_PROGRESS:
+		fake_playlist_update_in_progress(pl, b);
+		break;
+	default:
+		break;
+	}
+	t = stats_now_usec() - t;
+	stats[type].count++;
+	stats[type].total += t;
+	if(t > stats[type].max)
+		stats[type].max = t;
+	num_records++;
+out:
+	free(s);
+	free(tv);
+	free(iv);
+}
+
+
+/**
+ * Give the records that are due, at most REPLAY_BATCH of them, so that
+ * the main loop gets to do its other work in between.
+ *
+ * @return ms until the next one is due, -1 if the replay is over.
+ * */
+int replay_run_due(void){
+	int i;
+	if(!start_time)
+		start_time = stats_now_usec();
+	for(i = 0; i < REPLAY_BATCH; i++){
+		if(finished || cur >= end){
+			finished = 1;
+			break;
+		}
+		// The time of the next record, without taking it
+		const unsigned char *rec = cur++;
+		uint64_t at = next_at + get_varint();
+		cur = rec;
+		if(bad){
+			finished = 1;
+			break;
+		}
+		uint64_t now = stats_now_usec();
+		uint64_t due = start_time + (speed > 0 ? (uint64_t)(at / speed) : 0);
+		if(due > now)
+			return (due - now + 999) / 1000;
+		replay_one();
+	}
+	if(bad)
+		fprintf(stderr, "replay: the callback log is bad at byte %ld\n", (long)(cur - data));
+	bad = 0;
+	return finished ? -1 : 0;
+}
+
+
+int replay_finished(void){
+	return finished;
+}
+
+
+static int compare_u64(const void *a, const void *b){
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+
+static double quantile_ms(double q){
+	int i = (int)ceil(q * num_lags) - 1;
+	return lags[i < 0 ? 0 : i] / 1000.0;
+}
+
+
+/**
+ * How long the callbacks took, and how late they came.
+ * */
+void replay_report(FILE *f, uint64_t elapsed){
+	int i;
+	fprintf(f, "replay: %u callbacks in %.3f s", num_records, elapsed / 1e6);
+	if(speed > 0)
+		fprintf(f, " (at %g times the recorded speed)\n", speed);
+	else
+		fprintf(f, " (as fast as they could)\n");
+	fprintf(f, "  %-28s %8s %10s %10s %10s\n", "callback", "count", "total ms",
+	        "mean us", "max us");
+	for(i = 1; i < CBLOG_NUM_TYPES; i++){
+		if(!stats[i].count)
+			continue;
+		fprintf(f, "  %-28s %8u %10.3f %10.2f %10llu\n", cblog_type_names[i],
+		        stats[i].count, stats[i].total / 1000.0,
+		        (double)stats[i].total / stats[i].count,
+		        (unsigned long long)stats[i].max);
+	}
+	if(num_lags){
+		qsort(lags, num_lags, sizeof(*lags), compare_u64);
+		fprintf(f, "  %-28s p50 %.3f  p99 %.3f  p99.9 %.3f  max %.3f\n", "late by, ms",
+		        quantile_ms(0.5), quantile_ms(0.99), quantile_ms(0.999),
+		        lags[num_lags - 1] / 1000.0);
+	}
+}
@@ -0,0 +1,15 @@
+#ifndef REPLAY_H__
+#define REPLAY_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* The most records replay_run_due() gives in one go */
+#define REPLAY_BATCH 64
+
+int replay_open(const char *path, double speed);
+int replay_run_due(void);
+int replay_finished(void);
+void replay_report(FILE *f, uint64_t elapsed);
+
+#endif
@@ -0,0 +1,173 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "listify.h"
+#include "cmd.h"
+#include "link.h"
+#include "list.h"
+#include "ptrmap.h"
+#include "handle.h"
+#include "arena.h"
+
+
+/*
+ * Set operations over playlists: union, intersection and difference.
+ * Tracks are hashed on their handle, so each playlist is read once,
+ * and memory goes with the number of distinct tracks. The result
+ * keeps the order in which the tracks were first met, and is written
+ * to a new playlist.
+ * 
+ * */
+
+enum setop {
+	SETOP_UNION,
+	SETOP_INTERSECT,
+	SETOP_DIFF,
+};
+
+/// What a track maps to when it's already in the result
+#define TAKEN ((void*)UINTPTR_MAX)
+
+
+/**
+ * Put track in the result, unless it's there already.
+ * */
+static void take(struct ptrmap *seen, sp_track **out, int *n, sp_track *track){
+	if(ptrmap_get(seen, track) == TAKEN)
+		return;
+	ptrmap_put(seen, track, TAKEN);
+	out[(*n)++] = track;
+}
+
+
+/**
+ * Compute the result of op over the playlists.
+ * 
+ * @param out room for as many tracks as there are in pls[0], or in
+ *            all of them for a union.
+ * 
+ * @return the number of tracks in out, -1 if out of memory.
+ * */
+static int compute(enum setop op, sp_playlist **pls, int num, sp_track **out){
+	struct ptrmap seen;
+	int n = 0, i, k;
+	ptrmap_init(&seen);
+
+	switch(op){
+	case SETOP_UNION:
+		for(k = 0; k < num; k++)
+			for(i = 0; i < sp_playlist_num_tracks(pls[k]); i++)
+				take(&seen, out, &n, sp_playlist_track(pls[k], i));
+		break;
+	case SETOP_INTERSECT:
+		// A track maps to the number of playlists it has been in
+		// so far, in a row from the first one.
+		for(k = 0; k < num; k++){
+			for(i = 0; i < sp_playlist_num_tracks(pls[k]); i++){
+				sp_track *t = sp_playlist_track(pls[k], i);
+				if((uintptr_t)ptrmap_get(&seen, t) == (uintptr_t)k &&
+				   ptrmap_put(&seen, t, (void*)(uintptr_t)(k + 1)))
+					goto oom;
+			}
+		}
+		for(i = 0; i < sp_playlist_num_tracks(pls[0]); i++){
+			sp_track *t = sp_playlist_track(pls[0], i);
+			if((uintptr_t)ptrmap_get(&seen, t) == (uintptr_t)num)
+				take(&seen, out, &n, t);
+		}
+		break;
+	case SETOP_DIFF:
+		for(k = 1; k < num; k++)
+			for(i = 0; i < sp_playlist_num_tracks(pls[k]); i++)
+				if(ptrmap_put(&seen, sp_playlist_track(pls[k], i), TAKEN))
+					goto oom;
+		for(i = 0; i < sp_playlist_num_tracks(pls[0]); i++)
+			take(&seen, out, &n, sp_playlist_track(pls[0], i));
+		break;
+	}
+	ptrmap_free(&seen);
+	return n;
+oom:
+	ptrmap_free(&seen);
+	return -1;
+}
+
+
+/**
+ * The common part of the commands: read the playlists, compute the
+ * result and write it to a new playlist.
+ * 
+ * @param 1
+ * The name of the new playlist.
+ * @param 2..n
+ * The playlists, at least two, see cmd_arg_playlist().
+ * 
+ * @return -1.
+ * */
+static int run_setop(enum setop op, int argc, char **argv){
+	int num = argc - 2, k, n;
+	int total = 0;
+	sp_playlist **pls = arena_alloc(num * sizeof(sp_playlist*));
+	sp_track **out;
+
+	if(!pls){
+		fprintf(stderr, "Out of memory.\n");
+		return -1;
+	}
+	for(k = 0; k < num; k++){
+		pls[k] = cmd_arg_playlist(2 + k);
+		if(!sp_playlist_is_loaded(pls[k])){
+			fprintf(stderr, "The playlist %s isn't loaded yet, try again.\n", argv[2 + k]);
+			return -1;
+		}
+		if(op == SETOP_UNION || k == 0)
+			total += sp_playlist_num_tracks(pls[k]);
+	}
+
+	out = arena_alloc((total > 0 ? total : 1) * sizeof(sp_track*));
+	n = out ? compute(op, pls, num, out) : -1;
+	if(n < 0){
+		fprintf(stderr, "Out of memory.\n");
+		return -1;
+	}
+
+	char *URI = new_playlist(argv[1]);
+	if(!URI){
+		fprintf(stderr, "Failed in creating a new playlist\n");
+		return -1;
+	}
+	SCOPED_PLAYLIST sp_playlist *result = URI_to_playlist(URI);
+	if(result){
+		sp_error err = add_tracks_chunked(result, out, n, 0);
+		if(err != SP_ERROR_OK)
+			fprintf(stderr, "Error '%s' when trying to add the tracks.\n", sp_error_message(err));
+		else
+			printf("The new playlist has %d tracks and the URI\n%s\n", n, URI);
+	}
+	return -1;
+}
+
+
+/**
+ * Make a new playlist of the tracks that are in any of the given ones.
+ * */
+int cmd_union_playlists(int argc, char **argv){
+	return run_setop(SETOP_UNION, argc, argv);
+}
+
+
+/**
+ * Make a new playlist of the tracks that are in all of the given ones.
+ * */
+int cmd_intersect_playlists(int argc, char **argv){
+	return run_setop(SETOP_INTERSECT, argc, argv);
+}
+
+
+/**
+ * Make a new playlist of the tracks in the first of the given ones,
+ * that aren't in any of the others.
+ * */
+int cmd_diff_playlists(int argc, char **argv){
+	return run_setop(SETOP_DIFF, argc, argv);
+}
@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <time.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "listify.h"
+#include "cmd.h"
+#include "stats.h"
+
+
+/*
+ * Bookkeeping for the "stats" command. Everything here is touched from
+ * the main thread, except stats_first_prompt() which the prompt thread
+ * calls while it holds the notify mutex.
+ * 
+ * */
+
+/// When main() started, everything else is relative to this.
+static uint64_t start_time;
+
+/// When the prompt was first shown, 0 if not yet.
+static uint64_t first_prompt_time;
+
+/// When the first command was done, 0 if not yet.
+static uint64_t first_done_time;
+
+/// When the command currently running was started, 0 if none.
+static uint64_t command_start_time;
+
+static unsigned int commands_done;
+
+static unsigned int commands_timed_out;
+
+
+/**
+ * A monotonic clock, in microseconds.
+ */
+uint64_t stats_now_usec(void)
+{
+#if _POSIX_TIMERS > 0
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+}
+
+
+static double ms_since_start(uint64_t t)
+{
+	return (t - start_time) / 1000.0;
+}
+
+
+void stats_startup_begin(void)
+{
+	start_time = stats_now_usec();
+}
+
+
+void stats_first_prompt(void)
+{
+	if(!first_prompt_time)
+		first_prompt_time = stats_now_usec();
+}
+
+
+void stats_command_started(void)
+{
+	command_start_time = stats_now_usec();
+}
+
+
+/**
+ * Called from cmd_done(). Only counts if a command was actually run,
+ * as cmd_done() is also called for commands that never ran.
+ */
+void stats_command_done(void)
+{
+	if(!command_start_time)
+		return;
+	command_start_time = 0;
+	commands_done++;
+
+	if(!first_done_time) {
+		first_done_time = stats_now_usec();
+		fprintf(stderr, "listify: first prompt after %.1f ms, "
+		                "first command done after %.1f ms\n",
+		        ms_since_start(first_prompt_time),
+		        ms_since_start(first_done_time));
+	}
+}
+
+
+/**
+ * Called when a command was given up on, before its cmd_done().
+ */
+void stats_command_timed_out(void)
+{
+	commands_timed_out++;
+}
+
+
+/**
+ * Print what we know about this run.
+ * 
+ * @return -1.
+ */
+int cmd_stats(int argc, char **argv)
+{
+	printf("  %-30s %.1f ms\n", "uptime", ms_since_start(stats_now_usec()));
+	if(first_prompt_time)
+		printf("  %-30s %.1f ms\n", "time to first prompt",
+		       ms_since_start(first_prompt_time));
+	if(first_done_time)
+		printf("  %-30s %.1f ms\n", "time to first command done",
+		       ms_since_start(first_done_time));
+	printf("  %-30s %u\n", "commands done", commands_done);
+	printf("  %-30s %u\n", "commands timed out", commands_timed_out);
+	cmd_print_memory();
+	return -1;
+}
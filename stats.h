@@ -0,0 +1,13 @@
+#ifndef STATS_H__
+#define STATS_H__
+
+#include <stdint.h>
+
+uint64_t stats_now_usec(void);
+void stats_startup_begin(void);
+void stats_first_prompt(void);
+void stats_command_started(void);
+void stats_command_done(void);
+void stats_command_timed_out(void);
+
+#endif
@@ -0,0 +1,193 @@
+#include <fnmatch.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "listify.h"
+#include "link.h"
+#include "list.h"
+#include "lines.h"
+#include "uri.h"
+#include "handle.h"
+#include "arena.h"
+#include "targets.h"
+
+
+/*
+ * The playlists a command works on, when it takes many. Each argument
+ * is one of
+ * 
+ *   spotify:user:<user>:playlist:<id>   that playlist
+ *   file:<path>                         the playlist URIs in the file
+ *   glob:<pattern>                      the playlists of the container
+ *                                       with names matching the pattern,
+ *                                       with _ for spaces
+ * 
+ * All of them are looked for in one pass over the container, so many
+ * targets cost about as much as one. The targets come out in the order
+ * of the container, with those that aren't in it last. They are in the
+ * arena of the command, see arena.c.
+ * 
+ * */
+
+struct wanted {
+	struct spid id;
+	const char *URI;
+	int found;
+};
+
+
+static int wanted_cmp(const void *a, const void *b){
+	const struct wanted *x = a, *y = b;
+	if(x->id.hi != y->id.hi)
+		return x->id.hi < y->id.hi ? -1 : 1;
+	if(x->id.lo != y->id.lo)
+		return x->id.lo < y->id.lo ? -1 : 1;
+	return 0;
+}
+
+
+static int add_wanted(struct wanted **w, int *n, int *size, const char *URI){
+	struct uri u;
+	if(uri_parse(URI, &u) != URI_PLAYLIST){
+		fprintf(stderr, "Nothing was done, %s isn't a playlist URI\n", URI);
+		return -1;
+	}
+	if(*n == *size){
+		int new_size = *size ? 2 * *size : 16;
+		struct wanted *v = arena_realloc(*w, *size * sizeof(struct wanted),
+		                                 new_size * sizeof(struct wanted));
+		if(!v){
+			fprintf(stderr, "Out of memory.\n");
+			return -1;
+		}
+		*w = v;
+		*size = new_size;
+	}
+	(*w)[*n].id = u.id;
+	(*w)[*n].URI = URI;
+	(*w)[*n].found = 0;
+	(*n)++;
+	return 0;
+}
+
+
+static int add_target(struct targets *t, int *size, sp_playlist *pl, int index){
+	if(t->num == *size){
+		int new_size = *size ? 2 * *size : 16;
+		struct target *v = arena_realloc(t->v, *size * sizeof(struct target),
+		                                 new_size * sizeof(struct target));
+		if(!v){
+			fprintf(stderr, "Out of memory.\n");
+			return -1;
+		}
+		t->v = v;
+		*size = new_size;
+	}
+	t->v[t->num].pl = handle_playlist_ref(pl);
+	t->v[t->num].index = index;
+	t->num++;
+	return 0;
+}
+
+
+/**
+ * Find the playlists of the arguments.
+ * 
+ * @param out gets the targets, free them with targets_free().
+ * 
+ * @return -1 if any argument is bad, then there are no targets.
+ * */
+int targets_resolve(int argc, char **argv, struct targets *out){
+	struct lines *files = arena_alloc(argc * sizeof(struct lines));
+	char **globs = arena_alloc(argc * sizeof(char *));
+	struct wanted *wanted = NULL;
+	int num_files = 0, num_globs = 0, num_wanted = 0, wanted_size = 0;
+	int target_size = 0;
+	int i, j, r = -1;
+	char *cp;
+
+	out->num = 0;
+	out->v = NULL;
+	if(!files || !globs){
+		fprintf(stderr, "Out of memory.\n");
+		return -1;
+	}
+	for(i = 0; i < argc; i++){
+		if(!strncmp(argv[i], "file:", 5)){
+			if(lines_read(argv[i] + 5, &files[num_files]))
+				goto done;
+			struct lines *l = &files[num_files++];
+			for(j = 0; j < l->num; j++)
+				if(add_wanted(&wanted, &num_wanted, &wanted_size, l->line[j]))
+					goto done;
+		}else if(!strncmp(argv[i], "glob:", 5)){
+			globs[num_globs++] = argv[i] + 5;
+			for(cp = argv[i] + 5; *cp; cp++)
+				if(*cp == '_')
+					*cp = ' ';
+		}else if(add_wanted(&wanted, &num_wanted, &wanted_size, argv[i])){
+			goto done;
+		}
+	}
+	qsort(wanted, num_wanted, sizeof(struct wanted), wanted_cmp);
+
+	// The one pass over the container
+	int n = sp_playlistcontainer_num_playlists(g_pc);
+	for(i = 0; i < n; i++){
+		sp_playlist *pl = sp_playlistcontainer_playlist(g_pc, i);
+		int match = 0;
+		if(!pl)
+			continue;
+		if(num_globs){
+			const char *name = sp_playlist_name(pl);
+			for(j = 0; j < num_globs && !match; j++)
+				match = name && !fnmatch(globs[j], name, 0);
+		}
+		if(num_wanted){
+			struct wanted key, *w;
+			if(!playlist_id(pl, &key.id)){
+				w = bsearch(&key, wanted, num_wanted, sizeof(struct wanted), wanted_cmp);
+				if(w){
+					// All that are asked for twice are found
+					while(w > wanted && !wanted_cmp(w - 1, &key))
+						w--;
+					for(; w < wanted + num_wanted && !wanted_cmp(w, &key); w++)
+						w->found = 1;
+					match = 1;
+				}
+			}
+		}
+		if(match && add_target(out, &target_size, pl, i))
+			goto done;
+	}
+
+	// The rest aren't in the container, but can still be had
+	for(i = 0; i < num_wanted; i++){
+		if(wanted[i].found || (i > 0 && !wanted_cmp(&wanted[i - 1], &wanted[i])))
+			continue;
+		SCOPED_PLAYLIST sp_playlist *pl = URI_to_playlist(wanted[i].URI);
+		if(!pl){
+			fprintf(stderr, "The URI %s couldn't be converted to a playlist\n", wanted[i].URI);
+			goto done;
+		}
+		if(add_target(out, &target_size, pl, -1))
+			goto done;
+	}
+	r = 0;
+
+done:
+	for(i = 0; i < num_files; i++)
+		lines_free(&files[i]);
+	if(r)
+		targets_free(out);
+	return r;
+}
+
+
+void targets_free(struct targets *t){
+	int i;
+	for(i = 0; i < t->num; i++)
+		handle_playlist_release(&t->v[i].pl);
+	t->v = NULL;
+	t->num = 0;
+}
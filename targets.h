@@ -0,0 +1,23 @@
+#ifndef TARGETS_H__
+#define TARGETS_H__
+
+#include <libspotify/api.h>
+
+/*
+ * A playlist a command was asked to work on, and where it is in our
+ * container, -1 if it isn't in it.
+ */
+struct target {
+	sp_playlist *pl;
+	int index;
+};
+
+struct targets {
+	int num;
+	struct target *v;
+};
+
+int targets_resolve(int argc, char **argv, struct targets *out);
+void targets_free(struct targets *t);
+
+#endif
@@ -0,0 +1,124 @@
+#include <stdlib.h>
+#include "stats.h"
+#include "timer.h"
+
+
+/*
+ * A timer wheel on the monotonic clock. A timer goes in the slot of
+ * the tick it expires at, modulo TIMER_SLOTS, so adding and cancelling
+ * cost the same however many timers there are. Timers more than a
+ * turn of the wheel away are passed over until their turn comes.
+ * 
+ * timer_run() is called from the main loop after libspotify has had
+ * its events, and tells how soon it wants to be called again, which
+ * goes into the next_timeout of the loop. Everything here is for the
+ * main thread only.
+ * 
+ * */
+
+static struct timer *slots[TIMER_SLOTS];
+
+/// The tick up to which the timers have been run
+static uint64_t now_tick;
+static int num_pending;
+
+
+static uint64_t current_tick(void){
+	return stats_now_usec() / (TIMER_TICK_MS * 1000);
+}
+
+
+/**
+ * Call fn(t) in about ms milliseconds, not sooner. If t is pending
+ * already it is moved.
+ * */
+void timer_add(struct timer *t, timer_fn *fn, int ms){
+	timer_cancel(t);
+	if(!num_pending)
+		now_tick = current_tick();
+	if(ms < 0)
+		ms = 0;
+	// Rounded up, and a tick more as the current one has partly gone,
+	// a timer must not fire early
+	t->expires = current_tick() + (ms + TIMER_TICK_MS - 1) / TIMER_TICK_MS + 1;
+	if(t->expires <= now_tick)
+		t->expires = now_tick + 1;
+	t->fn = fn;
+
+	struct timer **slot = &slots[t->expires & (TIMER_SLOTS - 1)];
+	t->next = *slot;
+	t->pprev = slot;
+	if(*slot)
+		(*slot)->pprev = &t->next;
+	*slot = t;
+	num_pending++;
+}
+
+
+void timer_cancel(struct timer *t){
+	if(!t->pprev)
+		return;
+	*t->pprev = t->next;
+	if(t->next)
+		t->next->pprev = t->pprev;
+	t->next = NULL;
+	t->pprev = NULL;
+	num_pending--;
+}
+
+
+int timer_pending(const struct timer *t){
+	return t->pprev != NULL;
+}
+
+
+/**
+ * Fire the timers in a slot that expire by tick.
+ * */
+static void run_slot(struct timer **slot, uint64_t tick){
+	struct timer *t;
+again:
+	for(t = *slot; t; t = t->next){
+		if(t->expires <= tick){
+			timer_cancel(t);
+			t->fn(t);
+			// It may have changed the slot
+			goto again;
+		}
+	}
+}
+
+
+/**
+ * Fire the timers that have expired. A timer may be added or
+ * cancelled from the function of one.
+ * 
+ * @return the milliseconds until a timer may fire, at least 1 as 0
+ *         is no timeout to the main loop, -1 if none is pending.
+ * */
+int timer_run(void){
+	uint64_t tick = current_tick();
+	int i;
+
+	if(tick > now_tick && tick - now_tick >= TIMER_SLOTS){
+		// After a long sleep every slot is due, go around once
+		now_tick = tick;
+		for(i = 0; i < TIMER_SLOTS && num_pending; i++)
+			run_slot(&slots[i], tick);
+	}
+	while(now_tick < tick && num_pending){
+		now_tick++;
+		run_slot(&slots[now_tick & (TIMER_SLOTS - 1)], now_tick);
+	}
+	if(!num_pending)
+		return -1;
+
+	// The next slot with something in it, at most a turn away
+	for(i = 1; i < TIMER_SLOTS; i++)
+		if(slots[(now_tick + i) & (TIMER_SLOTS - 1)])
+			break;
+	uint64_t due = now_tick + i;
+	tick = current_tick();
+	// Slow timers may have made the next slot due already
+	return due > tick ? (int)(due - tick) * TIMER_TICK_MS : 1;
+}
@@ -0,0 +1,31 @@
+#ifndef TIMER_H__
+#define TIMER_H__
+
+#include <stdint.h>
+
+/* The resolution of the timers */
+#define TIMER_TICK_MS 10
+
+/* The slots of the wheel, a power of two */
+#define TIMER_SLOTS 256
+
+struct timer;
+typedef void timer_fn(struct timer *t);
+
+/*
+ * A timer, to be embedded in whatever it's for. It's pending from
+ * timer_add() until it has fired or been cancelled.
+ */
+struct timer {
+	struct timer *next;
+	struct timer **pprev;
+	uint64_t expires;       // in TIMER_TICK_MS ticks
+	timer_fn *fn;
+};
+
+void timer_add(struct timer *t, timer_fn *fn, int ms);
+void timer_cancel(struct timer *t);
+int timer_pending(const struct timer *t);
+int timer_run(void);
+
+#endif
@@ -0,0 +1,319 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "listify.h"
+#include "cmd.h"
+#include "link.h"
+#include "list.h"
+#include "ptrmap.h"
+#include "stats.h"
+#include "handle.h"
+#include "trackindex.h"
+
+
+/*
+ * An index from tracks to the playlists (and positions) they are in,
+ * for the "where" command.
+ * 
+ * The index is built the first time it's asked, and from then on all
+ * playlists in the container are pinned (see playlist_pin()) so that
+ * the playlist callbacks keep it current. Adds and removals are
+ * applied as they come; moves are rare, so the playlist is simply
+ * indexed again.
+ * 
+ * Tracks are keyed on their handle. libspotify has exactly one
+ * sp_track per track, so the handle is as good an id as any.
+ * 
+ * */
+
+struct posting {
+	sp_playlist *pl;
+	int pos;
+};
+
+/// Where one track is
+struct postings {
+	int num;
+	int cap;
+	struct posting *v;
+};
+
+/// Our copy of the track order of one playlist
+struct mirror {
+	int loaded;
+	int num;
+	int cap;
+	sp_track **t;
+};
+
+/// Set once the index has been built
+static int active;
+
+/// sp_track* --> struct postings*
+static struct ptrmap by_track;
+
+/// sp_playlist* --> struct mirror*
+static struct ptrmap by_playlist;
+
+
+static void posting_add(sp_track *track, sp_playlist *pl, int pos){
+	struct postings *p = ptrmap_get(&by_track, track);
+	if(!p){
+		p = calloc(1, sizeof(*p));
+		if(!p || ptrmap_put(&by_track, track, p)){
+			free(p);
+			fprintf(stderr, "Out of memory, the track index is incomplete.\n");
+			return;
+		}
+		handle_track_ref(track);
+	}
+	if(p->num == p->cap){
+		int cap = p->cap ? p->cap * 2 : 2;
+		struct posting *v = realloc(p->v, cap * sizeof(*v));
+		if(!v){
+			fprintf(stderr, "Out of memory, the track index is incomplete.\n");
+			return;
+		}
+		p->v = v;
+		p->cap = cap;
+	}
+	p->v[p->num].pl = pl;
+	p->v[p->num].pos = pos;
+	p->num++;
+}
+
+
+static struct posting *posting_find(struct postings *p, sp_playlist *pl, int pos){
+	int i;
+	if(p)
+		for(i = 0; i < p->num; i++)
+			if(p->v[i].pl == pl && p->v[i].pos == pos)
+				return &p->v[i];
+	return NULL;
+}
+
+
+static void posting_remove(sp_track *track, sp_playlist *pl, int pos){
+	struct postings *p = ptrmap_get(&by_track, track);
+	struct posting *hit = posting_find(p, pl, pos);
+	if(!hit)
+		return;
+	*hit = p->v[--p->num];
+	if(p->num == 0){
+		ptrmap_remove(&by_track, track);
+		handle_track_release(&track);
+		free(p->v);
+		free(p);
+	}
+}
+
+
+static void posting_move(sp_track *track, sp_playlist *pl, int from, int to){
+	struct posting *hit = posting_find(ptrmap_get(&by_track, track), pl, from);
+	if(hit)
+		hit->pos = to;
+}
+
+
+static int mirror_reserve(struct mirror *m, int num){
+	if(num <= m->cap)
+		return 0;
+	int cap = m->cap ? m->cap : 16;
+	while(cap < num)
+		cap *= 2;
+	sp_track **t = realloc(m->t, cap * sizeof(*t));
+	if(!t)
+		return -1;
+	m->t = t;
+	m->cap = cap;
+	return 0;
+}
+
+
+/**
+ * Forget the tracks of a playlist.
+ * */
+static void mirror_clear(sp_playlist *pl, struct mirror *m){
+	int i;
+	for(i = 0; i < m->num; i++)
+		posting_remove(m->t[i], pl, i);
+	m->num = 0;
+	m->loaded = 0;
+}
+
+
+/**
+ * Read all tracks of a playlist, if it's loaded.
+ * */
+static void mirror_fill(sp_playlist *pl, struct mirror *m){
+	mirror_clear(pl, m);
+	if(!sp_playlist_is_loaded(pl))
+		return; // trackindex_playlist_loaded() tries again
+	int n = sp_playlist_num_tracks(pl);
+	if(mirror_reserve(m, n)){
+		fprintf(stderr, "Out of memory, can't index %s.\n", sp_playlist_name(pl));
+		return;
+	}
+	int i;
+	for(i = 0; i < n; i++){
+		m->t[i] = sp_playlist_track(pl, i);
+		posting_add(m->t[i], pl, i);
+	}
+	m->num = n;
+	m->loaded = 1;
+}
+
+
+/**
+ * If our copy has drifted from the playlist, read it all again.
+ * */
+static void mirror_check(sp_playlist *pl, struct mirror *m){
+	if(m->num != sp_playlist_num_tracks(pl))
+		mirror_fill(pl, m);
+}
+
+
+/**
+ * Start indexing a playlist.
+ * */
+static void index_playlist(sp_playlist *pl){
+	if(ptrmap_get(&by_playlist, pl))
+		return;
+	struct mirror *m = calloc(1, sizeof(*m));
+	if(!m || ptrmap_put(&by_playlist, pl, m)){
+		free(m);
+		fprintf(stderr, "Out of memory, can't index %s.\n", sp_playlist_name(pl));
+		return;
+	}
+	playlist_pin(pl);
+	mirror_fill(pl, m);
+}
+
+
+/**
+ * Index every playlist in the container.
+ * */
+static void trackindex_build(void){
+	int i, n = sp_playlistcontainer_num_playlists(g_pc);
+	uint64_t t0 = stats_now_usec();
+	active = 1;
+	for(i = 0; i < n; i++)
+		index_playlist(sp_playlistcontainer_playlist(g_pc, i));
+	printf("Indexed %d playlists in %.1f ms, the rest is indexed as it loads.\n",
+	       n, (stats_now_usec() - t0) / 1000.0);
+}
+
+
+void trackindex_playlist_added(sp_playlist *pl){
+	if(active)
+		index_playlist(pl);
+}
+
+
+void trackindex_playlist_removed(sp_playlist *pl){
+	struct mirror *m = ptrmap_remove(&by_playlist, pl);
+	if(!m)
+		return;
+	mirror_clear(pl, m);
+	free(m->t);
+	free(m);
+	playlist_unpin(pl);
+}
+
+
+void trackindex_playlist_loaded(sp_playlist *pl){
+	struct mirror *m = ptrmap_get(&by_playlist, pl);
+	if(m && !m->loaded)
+		mirror_fill(pl, m);
+}
+
+
+void trackindex_tracks_added(sp_playlist *pl, sp_track * const *tracks, int n, int position){
+	struct mirror *m = ptrmap_get(&by_playlist, pl);
+	if(!m || !m->loaded)
+		return;
+	if(position < 0 || position > m->num || mirror_reserve(m, m->num + n)){
+		mirror_fill(pl, m);
+		return;
+	}
+	int i;
+	// From the back, so that no position is taken twice
+	for(i = m->num - 1; i >= position; i--){
+		posting_move(m->t[i], pl, i, i + n);
+		m->t[i + n] = m->t[i];
+	}
+	for(i = 0; i < n; i++){
+		m->t[position + i] = tracks[i];
+		posting_add(tracks[i], pl, position + i);
+	}
+	m->num += n;
+	mirror_check(pl, m);
+}
+
+
+void trackindex_tracks_removed(sp_playlist *pl, const int *tracks, int n){
+	struct mirror *m = ptrmap_get(&by_playlist, pl);
+	if(!m || !m->loaded || m->num == 0)
+		return;
+	char *gone = calloc(m->num, 1);
+	if(!gone){
+		mirror_fill(pl, m);
+		return;
+	}
+	int i, j;
+	for(i = 0; i < n; i++)
+		if(tracks[i] >= 0 && tracks[i] < m->num)
+			gone[tracks[i]] = 1;
+	// From the front, so that no position is taken twice
+	for(i = j = 0; i < m->num; i++){
+		if(gone[i]){
+			posting_remove(m->t[i], pl, i);
+			continue;
+		}
+		if(i != j){
+			posting_move(m->t[i], pl, i, j);
+			m->t[j] = m->t[i];
+		}
+		j++;
+	}
+	m->num = j;
+	free(gone);
+	mirror_check(pl, m);
+}
+
+
+void trackindex_tracks_moved(sp_playlist *pl){
+	struct mirror *m = ptrmap_get(&by_playlist, pl);
+	if(m && m->loaded)
+		mirror_fill(pl, m);
+}
+
+
+/**
+ * Tell which playlists contain a track, and where.
+ * 
+ * @param 1
+ * The full URI of the track, like:
+ * spotify:track:3GhpgjhCNZZa6Lb7Wtrp3S
+ * 
+ * @return -1.
+ * */
+int cmd_where(int argc, char **argv){
+	sp_track *track = cmd_arg_track(1);
+
+	if(!active)
+		trackindex_build();
+
+	uint64_t t0 = stats_now_usec();
+	struct postings *p = ptrmap_get(&by_track, track);
+	uint64_t t1 = stats_now_usec();
+
+	int i, n = p ? p->num : 0;
+	for(i = 0; i < n; i++){
+		char buff[256];
+		playlist_to_URI(p->v[i].pl, buff, sizeof(buff));
+		printf("  %6d  %-30s %s\n", p->v[i].pos, sp_playlist_name(p->v[i].pl), buff);
+	}
+	printf("%d hits, found in %u us.\n", n, (unsigned int)(t1 - t0));
+	return -1;
+}
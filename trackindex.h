@@ -0,0 +1,13 @@
+#ifndef TRACKINDEX_H__
+#define TRACKINDEX_H__
+
+#include <libspotify/api.h>
+
+void trackindex_playlist_added(sp_playlist *pl);
+void trackindex_playlist_removed(sp_playlist *pl);
+void trackindex_playlist_loaded(sp_playlist *pl);
+void trackindex_tracks_added(sp_playlist *pl, sp_track * const *tracks, int n, int position);
+void trackindex_tracks_removed(sp_playlist *pl, const int *tracks, int n);
+void trackindex_tracks_moved(sp_playlist *pl);
+
+#endif
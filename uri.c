@@ -0,0 +1,272 @@
+#include <stdio.h>
+#include <string.h>
+#include "uri.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+/*
+ * A local codec for Spotify URIs, so that ids can be checked, compared
+ * and stored as 16 byte numbers without going through libspotify.
+ * 
+ * The digits go 0-9, a-z, A-Z, most significant first.
+ * 
+ * */
+
+static const char DIGITS[] =
+	"0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+static const struct {
+	const char *prefix;
+	enum uri_kind kind;
+} PREFIXES[] = {
+	{ "spotify:track:",  URI_TRACK },
+	{ "spotify:album:",  URI_ALBUM },
+	{ "spotify:artist:", URI_ARTIST },
+};
+
+
+#ifndef __SSE2__
+static int digit_value(unsigned char c){
+	if(c >= '0' && c <= '9')
+		return c - '0';
+	if(c >= 'a' && c <= 'z')
+		return c - 'a' + 10;
+	if(c >= 'A' && c <= 'Z')
+		return c - 'A' + 36;
+	return -1;
+}
+#endif
+
+
+/**
+ * Turn the SPID_LENGTH characters at s into their digit values.
+ * 
+ * @return -1 if any of them isn't a base62 digit. 0 otherwise.
+ * */
+static int digit_values(const char *s, unsigned char *v){
+#ifdef __SSE2__
+	// Two overlapping 16 byte loads cover the 22 characters
+	static const int offsets[2] = { 0, SPID_LENGTH - 16 };
+	int k;
+	for(k = 0; k < 2; k++){
+		__m128i c = _mm_loadu_si128((const __m128i*)(s + offsets[k]));
+		__m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+		                              _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+		__m128i lower = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('a' - 1)),
+		                              _mm_cmplt_epi8(c, _mm_set1_epi8('z' + 1)));
+		__m128i upper = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('A' - 1)),
+		                              _mm_cmplt_epi8(c, _mm_set1_epi8('Z' + 1)));
+		__m128i ok = _mm_or_si128(digit, _mm_or_si128(lower, upper));
+		if(_mm_movemask_epi8(ok) != 0xffff)
+			return -1;
+		// What to subtract from each character to get its value
+		__m128i sub = _mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8('0')),
+		              _mm_or_si128(_mm_and_si128(lower, _mm_set1_epi8('a' - 10)),
+		                           _mm_and_si128(upper, _mm_set1_epi8('A' - 36))));
+		_mm_storeu_si128((__m128i*)(v + offsets[k]), _mm_sub_epi8(c, sub));
+	}
+	return 0;
+#else
+	int i;
+	for(i = 0; i < SPID_LENGTH; i++){
+		int d = digit_value(s[i]);
+		if(d < 0)
+			return -1;
+		v[i] = d;
+	}
+	return 0;
+#endif
+}
+
+
+/**
+ * Multiply id by m and add a, both less than 2^32.
+ * 
+ * @return -1 if it overflows 128 bits. 0 otherwise.
+ * */
+static int mul_add(struct spid *id, uint32_t m, uint32_t a){
+	uint64_t limb[4] = {
+		id->lo & 0xffffffff, id->lo >> 32,
+		id->hi & 0xffffffff, id->hi >> 32
+	};
+	uint64_t carry = a;
+	int i;
+	for(i = 0; i < 4; i++){
+		uint64_t x = limb[i] * m + carry;
+		limb[i] = x & 0xffffffff;
+		carry = x >> 32;
+	}
+	if(carry)
+		return -1;
+	id->lo = limb[0] | limb[1] << 32;
+	id->hi = limb[2] | limb[3] << 32;
+	return 0;
+}
+
+
+/**
+ * Divide id by d, less than 2^32.
+ * 
+ * @return the remainder.
+ * */
+static uint32_t div_mod(struct spid *id, uint32_t d){
+	uint64_t limb[4] = {
+		id->hi >> 32, id->hi & 0xffffffff,
+		id->lo >> 32, id->lo & 0xffffffff
+	};
+	uint64_t rem = 0;
+	int i;
+	for(i = 0; i < 4; i++){
+		uint64_t x = rem << 32 | limb[i];
+		limb[i] = x / d;
+		rem = x % d;
+	}
+	id->hi = limb[0] << 32 | limb[1];
+	id->lo = limb[2] << 32 | limb[3];
+	return rem;
+}
+
+
+/**
+ * Decode the SPID_LENGTH base62 digits at s. s must have at least that
+ * many characters, but needn't end after them.
+ * 
+ * @return -1 if they aren't base62 digits or don't fit 128 bits.
+ *         0 otherwise.
+ * */
+int spid_decode(const char *s, struct spid *id){
+	unsigned char v[32];
+	int i;
+	if(digit_values(s, v))
+		return -1;
+	id->hi = 0;
+	id->lo = 0;
+	// Five digits at a time, 62^5 fits 32 bits
+	for(i = 0; i < SPID_LENGTH; i += 5){
+		uint32_t m = 1, a = 0;
+		int j;
+		for(j = i; j < i + 5 && j < SPID_LENGTH; j++){
+			m *= 62;
+			a = a * 62 + v[j];
+		}
+		if(mul_add(id, m, a))
+			return -1;
+	}
+	return 0;
+}
+
+
+/**
+ * Encode id as SPID_LENGTH base62 digits, plus a terminating '\0'.
+ * */
+void spid_encode(const struct spid *id, char *s){
+	struct spid rest = *id;
+	int i;
+	for(i = SPID_LENGTH - 1; i >= 0; i--)
+		s[i] = DIGITS[div_mod(&rest, 62)];
+	s[SPID_LENGTH] = '\0';
+}
+
+
+int spid_equal(const struct spid *a, const struct spid *b){
+	return a->hi == b->hi && a->lo == b->lo;
+}
+
+
+/**
+ * Is s exactly an id, ending where the id ends?
+ * */
+static int parse_id(const char *s, struct spid *id){
+	if(strnlen(s, SPID_LENGTH + 1) != SPID_LENGTH)
+		return -1;
+	return spid_decode(s, id);
+}
+
+
+/**
+ * Parse a track, album, artist or playlist URI, like
+ * spotify:track:3GhpgjhCNZZa6Lb7Wtrp3S or
+ * spotify:user:JohnSmith:playlist:68sMl8CBblj6uBcqbJsnoj
+ * 
+ * @param out may be NULL, if only the kind is wanted.
+ * 
+ * @return the kind, URI_INVALID if it's none of them.
+ * */
+enum uri_kind uri_parse(const char *s, struct uri *out){
+	struct uri u;
+	int i;
+	memset(&u, 0, sizeof(u));
+
+	for(i = 0; i < sizeof(PREFIXES) / sizeof(PREFIXES[0]); i++){
+		size_t len = strlen(PREFIXES[i].prefix);
+		if(!strncmp(s, PREFIXES[i].prefix, len)){
+			if(parse_id(s + len, &u.id))
+				return URI_INVALID;
+			u.kind = PREFIXES[i].kind;
+			break;
+		}
+	}
+	if(u.kind == URI_INVALID && !strncmp(s, "spotify:user:", 13)){
+		const char *user = s + 13;
+		const char *end = strchr(user, ':');
+		if(!end || end == user || end - user > 255 || strncmp(end, ":playlist:", 10))
+			return URI_INVALID;
+		if(parse_id(end + 10, &u.id))
+			return URI_INVALID;
+		u.kind = URI_PLAYLIST;
+		u.user = user;
+		u.user_len = end - user;
+	}
+	if(out)
+		*out = u;
+	return u.kind;
+}
+
+
+/**
+ * Write the URI for u.
+ * 
+ * @return the length of the URI, or -1 if it didn't fit.
+ * */
+int uri_format(const struct uri *u, char *buf, size_t size){
+	char id[SPID_LENGTH + 1];
+	int n = -1;
+	spid_encode(&u->id, id);
+	switch(u->kind){
+	case URI_TRACK:
+		n = snprintf(buf, size, "spotify:track:%s", id);
+		break;
+	case URI_ALBUM:
+		n = snprintf(buf, size, "spotify:album:%s", id);
+		break;
+	case URI_ARTIST:
+		n = snprintf(buf, size, "spotify:artist:%s", id);
+		break;
+	case URI_PLAYLIST:
+		n = snprintf(buf, size, "spotify:user:%.*s:playlist:%s", u->user_len, u->user, id);
+		break;
+	default:
+		break;
+	}
+	return n >= 0 && (size_t)n < size ? n : -1;
+}
+
+
+/**
+ * Parse many URIs, for checking the input of the bulk commands before
+ * any of it goes to libspotify.
+ * 
+ * @param out room for n parsed URIs, may be NULL.
+ * 
+ * @return the index of the first bad URI, -1 if all are good.
+ * */
+int uri_parse_bulk(char **uris, int n, struct uri *out){
+	int i;
+	for(i = 0; i < n; i++)
+		if(uri_parse(uris[i], out ? &out[i] : NULL) == URI_INVALID)
+			return i;
+	return -1;
+}
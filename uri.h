@@ -0,0 +1,46 @@
+#ifndef URI_H__
+#define URI_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* The 22 base62 digits of a Spotify id */
+#define SPID_LENGTH 22
+
+/*
+ * A track, album, artist or playlist id as a 128 bit number, which is
+ * what the base62 digits in its URI stand for.
+ */
+struct spid {
+	uint64_t hi;
+	uint64_t lo;
+};
+
+enum uri_kind {
+	URI_INVALID,
+	URI_TRACK,
+	URI_ALBUM,
+	URI_ARTIST,
+	URI_PLAYLIST,
+};
+
+/*
+ * A parsed URI. For playlists, user points into the parsed string and
+ * is user_len long.
+ */
+struct uri {
+	enum uri_kind kind;
+	struct spid id;
+	const char *user;
+	int user_len;
+};
+
+int spid_decode(const char *s, struct spid *id);
+void spid_encode(const struct spid *id, char *s);
+int spid_equal(const struct spid *a, const struct spid *b);
+
+enum uri_kind uri_parse(const char *s, struct uri *out);
+int uri_format(const struct uri *u, char *buf, size_t size);
+int uri_parse_bulk(char **uris, int n, struct uri *out);
+
+#endif
@@ -0,0 +1,484 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "listify.h"
+#include "cmd.h"
+#include "link.h"
+#include "list.h"
+#include "uri.h"
+#include "handle.h"
+#include "arena.h"
+#include "pending.h"
+#include "vlist.h"
+
+
+/*
+ * A virtual playlist is one name for tracks spread over many real
+ * playlists, the shards, so that no playlist grows past the size where
+ * the server gets slow. The shards of "name" are the playlists in our
+ * container called "name #1", "name #2", ..., and the virtual playlist
+ * is their tracks one after another, in the order of the numbers.
+ * Nothing more is kept anywhere, so the shards are found again from
+ * the container every time.
+ * 
+ * Tracks are appended to the last shard, and once it is full to new
+ * ones. When shards drift, because tracks were removed from them or
+ * added to them behind our back, they are rebalanced: tracks at the
+ * end of an overfull shard go to the start of the next, an underfull
+ * one is filled up from the start of the next, and shards that end up
+ * empty are removed. This keeps the order and only touches the shards
+ * that drifted.
+ * 
+ * */
+
+static int shard_size = VLIST_SHARD_SIZE;
+
+struct vlist {
+	char name[256];
+	int num;            // the number of shards
+	int size;           // the room in shards
+	sp_playlist **shards;
+	int *numbers;       // the number in the name of each shard
+};
+
+
+static void vlist_free(struct vlist *v){
+	int i;
+	for(i = 0; i < v->num; i++)
+		handle_playlist_release(&v->shards[i]);
+	free(v->shards);
+	free(v->numbers);
+}
+
+
+/**
+ * @return the shard number in the name of pl if it is a shard of v,
+ *         otherwise 0.
+ * */
+static int shard_number(struct vlist *v, sp_playlist *pl){
+	const char *name = sp_playlist_name(pl);
+	size_t len = strlen(v->name);
+	char *end;
+	if(!name || strncmp(name, v->name, len) || strncmp(name + len, " #", 2))
+		return 0;
+	long k = strtol(name + len + 2, &end, 10);
+	if(*end || end == name + len + 2 || k < 1 || k > 1000000)
+		return 0;
+	return k;
+}
+
+
+static int vlist_insert(struct vlist *v, sp_playlist *pl, int number){
+	int i;
+	if(v->num == v->size){
+		int size = v->size ? 2 * v->size : 8;
+		sp_playlist **shards = realloc(v->shards, size * sizeof(sp_playlist*));
+		if(!shards)
+			return -1;
+		v->shards = shards;
+		int *numbers = realloc(v->numbers, size * sizeof(int));
+		if(!numbers)
+			return -1;
+		v->numbers = numbers;
+		v->size = size;
+	}
+	for(i = v->num; i > 0 && v->numbers[i - 1] > number; i--){
+		v->shards[i] = v->shards[i - 1];
+		v->numbers[i] = v->numbers[i - 1];
+	}
+	v->shards[i] = handle_playlist_ref(pl);
+	v->numbers[i] = number;
+	v->num++;
+	return 0;
+}
+
+
+/**
+ * Find the shards of the virtual playlist called name, as spelled on
+ * the command line, with _ for spaces.
+ * 
+ * @return -1 if not all of them are loaded, or out of memory.
+ * */
+static int vlist_open(const char *name, struct vlist *v){
+	int i, n = sp_playlistcontainer_num_playlists(g_pc);
+	char *cp;
+
+	memset(v, 0, sizeof(*v));
+	snprintf(v->name, sizeof(v->name), "%s", name);
+	for(cp = v->name; *cp; cp++)
+		if(*cp == '_')
+			*cp = ' ';
+
+	for(i = 0; i < n; i++){
+		sp_playlist *pl = sp_playlistcontainer_playlist(g_pc, i);
+		int k = pl ? shard_number(v, pl) : 0;
+		if(!k)
+			continue;
+		if(!sp_playlist_is_loaded(pl)){
+			fprintf(stderr, "The shard %s isn't loaded yet, try again.\n", sp_playlist_name(pl));
+			vlist_free(v);
+			return -1;
+		}
+		if(vlist_insert(v, pl, k)){
+			fprintf(stderr, "Out of memory.\n");
+			vlist_free(v);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+
+/**
+ * Create a shard, numbered after the last one.
+ * 
+ * @return the new shard, NULL if failed.
+ * */
+static sp_playlist *vlist_new_shard(struct vlist *v){
+	char name[300];
+	int k = v->num ? v->numbers[v->num - 1] + 1 : 1;
+	snprintf(name, sizeof(name), "%s #%d", v->name, k);
+
+	char *URI = new_playlist(name);
+	if(!URI)
+		return NULL;
+	SCOPED_PLAYLIST sp_playlist *pl = URI_to_playlist(URI);
+	if(!pl || vlist_insert(v, pl, k))
+		return NULL;
+	return pl;
+}
+
+
+/**
+ * Remove the shard i from the container.
+ * */
+static void vlist_drop_shard(struct vlist *v, int i){
+	int j, n = sp_playlistcontainer_num_playlists(g_pc);
+	for(j = 0; j < n; j++){
+		if(sp_playlistcontainer_playlist(g_pc, j) == v->shards[i]){
+			sp_playlistcontainer_remove_playlist(g_pc, j);
+			break;
+		}
+	}
+	handle_playlist_release(&v->shards[i]);
+	for(j = i + 1; j < v->num; j++){
+		v->shards[j - 1] = v->shards[j];
+		v->numbers[j - 1] = v->numbers[j];
+	}
+	v->num--;
+}
+
+
+static int num_tracks(struct vlist *v){
+	int i, n = 0;
+	for(i = 0; i < v->num; i++)
+		n += sp_playlist_num_tracks(v->shards[i]);
+	return n;
+}
+
+
+/**
+ * Move n tracks of src, from index from, to dst at index to.
+ * 
+ * @return -1 if failed.
+ * */
+static int move_tracks(sp_playlist *src, int from, sp_playlist *dst, int to, int n){
+	sp_track **tracks = arena_alloc(n * sizeof(sp_track*));
+	int *indices = arena_alloc(n * sizeof(int));
+	int i, r = -1;
+	if(!tracks || !indices){
+		fprintf(stderr, "Out of memory.\n");
+		goto done;
+	}
+	for(i = 0; i < n; i++){
+		tracks[i] = sp_playlist_track(src, from + i);
+		indices[i] = from + i;
+	}
+	sp_error err = add_tracks_chunked(dst, tracks, n, to);
+	if(err == SP_ERROR_OK)
+		err = sp_playlist_remove_tracks(src, indices, n);
+	if(err == SP_ERROR_OK)
+		pending_changed(src, n);
+	if(err != SP_ERROR_OK){
+		fprintf(stderr, "Error '%s' when moving tracks between shards.\n", sp_error_message(err));
+		goto done;
+	}
+	r = 0;
+done:
+	return r;
+}
+
+
+/**
+ * Bring the shards back to between the low water mark and the shard
+ * size, and remove those that are empty. The first shard is kept,
+ * even if empty, so the virtual playlist goes on existing.
+ * 
+ * @return the number of shards that were changed, -1 if failed.
+ * */
+static int vlist_rebalance(struct vlist *v){
+	int low = shard_size * VLIST_LOW_WATER / 100;
+	int i, changed = 0;
+
+	for(i = 0; i < v->num; i++){
+		sp_playlist *pl = v->shards[i];
+		int n = sp_playlist_num_tracks(pl);
+		if(n > shard_size){
+			sp_playlist *next = i + 1 < v->num ? v->shards[i + 1] : vlist_new_shard(v);
+			if(!next || move_tracks(pl, shard_size, next, 0, n - shard_size))
+				return -1;
+			changed++;
+		}else if(n < low && i + 1 < v->num){
+			sp_playlist *next = v->shards[i + 1];
+			int m = sp_playlist_num_tracks(next);
+			if(m > shard_size - n)
+				m = shard_size - n;
+			if(m <= 0)
+				continue;
+			if(move_tracks(next, 0, pl, n, m))
+				return -1;
+			changed++;
+		}
+	}
+	for(i = v->num - 1; i > 0; i--){
+		if(sp_playlist_num_tracks(v->shards[i]) == 0){
+			vlist_drop_shard(v, i);
+			changed++;
+		}
+	}
+	return changed;
+}
+
+
+/**
+ * Append tracks to the end of the virtual playlist, filling up the
+ * last shard and then new ones.
+ * 
+ * @return -1 if failed.
+ * */
+static int vlist_append(struct vlist *v, sp_track **tracks, int n){
+	while(n > 0){
+		sp_playlist *last = v->num ? v->shards[v->num - 1] : NULL;
+		int room = last ? shard_size - sp_playlist_num_tracks(last) : 0;
+		if(room <= 0){
+			last = vlist_new_shard(v);
+			if(!last){
+				fprintf(stderr, "Couldn't create a new shard for %s\n", v->name);
+				return -1;
+			}
+			room = shard_size;
+		}
+		int chunk = n < room ? n : room;
+		sp_error err = add_tracks_chunked(last, tracks, chunk, -1);
+		if(err != SP_ERROR_OK){
+			fprintf(stderr, "Error '%s' when trying to add tracks to %s.\n", sp_error_message(err), sp_playlist_name(last));
+			return -1;
+		}
+		tracks += chunk;
+		n -= chunk;
+	}
+	return 0;
+}
+
+
+/**
+ * Append the tracks of a playlist, ADD_CHUNK at a time.
+ * 
+ * @return the number of tracks appended, -1 if failed.
+ * */
+static int vlist_append_playlist(struct vlist *v, const char *URI){
+	SCOPED_PLAYLIST sp_playlist *src = URI_to_playlist(URI);
+	if(!src){
+		fprintf(stderr, "The URI %s couldn't be converted to a playlist\n", URI);
+		return -1;
+	}
+	if(!sp_playlist_is_loaded(src)){
+		fprintf(stderr, "The playlist %s isn't loaded yet, try again.\n", URI);
+		return -1;
+	}
+	sp_track *batch[ADD_CHUNK];
+	int n = sp_playlist_num_tracks(src);
+	int i, j;
+	for(i = 0; i < n; i += j){
+		for(j = 0; j < ADD_CHUNK && i + j < n; j++)
+			batch[j] = sp_playlist_track(src, i + j);
+		if(vlist_append(v, batch, j))
+			return -1;
+	}
+	return n;
+}
+
+
+/**
+ * Add tracks to the end of a virtual playlist, which is created if it
+ * doesn't exist.
+ * 
+ * @param 1
+ * The name of the virtual playlist.
+ * @param 2..n
+ * Full URIs of tracks, or of playlists to take all the tracks of.
+ * 
+ * @return -1.
+ * */
+int cmd_vlist_add(int argc, char **argv){
+	int i, added = 0;
+	for(i = 2; i < argc; i++){
+		enum uri_kind kind = uri_parse(argv[i], NULL);
+		if(kind != URI_TRACK && kind != URI_PLAYLIST){
+			fprintf(stderr, "Nothing was added, %s is no track or playlist URI\n", argv[i]);
+			return -1;
+		}
+	}
+
+	struct vlist v;
+	if(vlist_open(argv[1], &v))
+		return -1;
+	for(i = 2; i < argc; i++){
+		SCOPED_LINK sp_link *link = handle_link(sp_link_create_from_string(argv[i]));
+		sp_linktype lt = link ? sp_link_type(link) : SP_LINKTYPE_INVALID;
+		if(lt == SP_LINKTYPE_PLAYLIST){
+			int n = vlist_append_playlist(&v, argv[i]);
+			if(n < 0)
+				break;
+			added += n;
+			continue;
+		}
+		sp_track *track = lt == SP_LINKTYPE_TRACK ? sp_link_as_track(link) : NULL;
+		if(!track){
+			fprintf(stderr, "%s is no track or playlist, stopped there.\n", argv[i]);
+			break;
+		}
+		if(vlist_append(&v, &track, 1))
+			break;
+		added++;
+	}
+	vlist_rebalance(&v);
+	printf("Added %d tracks, %s has %d tracks in %d shards.\n", added, v.name, num_tracks(&v), v.num);
+	vlist_free(&v);
+	return -1;
+}
+
+
+/**
+ * Remove all tracks of a virtual playlist, and all but its first shard.
+ * 
+ * @param 1
+ * The name of the virtual playlist.
+ * 
+ * @return -1.
+ * */
+int cmd_vlist_clear(int argc, char **argv){
+	struct vlist v;
+	int i;
+	if(vlist_open(argv[1], &v))
+		return -1;
+	for(i = 0; i < v.num; i++)
+		if(clear_tracks(v.shards[i]) != SP_ERROR_OK)
+			break;
+	vlist_rebalance(&v);
+	vlist_free(&v);
+	return -1;
+}
+
+
+/**
+ * Count the tracks of a virtual playlist, and of each shard.
+ * 
+ * @param 1
+ * The name of the virtual playlist.
+ * 
+ * @return -1.
+ * */
+int cmd_vlist_count(int argc, char **argv){
+	struct vlist v;
+	int i;
+	if(vlist_open(argv[1], &v))
+		return -1;
+	for(i = 0; i < v.num; i++)
+		printf("  %s: %d\n", sp_playlist_name(v.shards[i]), sp_playlist_num_tracks(v.shards[i]));
+	printf("%i tracks.\n", num_tracks(&v));
+	vlist_free(&v);
+	return -1;
+}
+
+
+/**
+ * Write the track URIs of a virtual playlist to a file, one per line
+ * and in order, as add_file reads them.
+ * 
+ * @param 1
+ * The name of the virtual playlist.
+ * @param 2
+ * The file to write.
+ * 
+ * @return -1.
+ * */
+int cmd_vlist_export(int argc, char **argv){
+	struct vlist v;
+	if(vlist_open(argv[1], &v))
+		return -1;
+	FILE *f = fopen(argv[2], "w");
+	if(!f){
+		perror(argv[2]);
+		vlist_free(&v);
+		return -1;
+	}
+	char URI[256];
+	int i, j, written = 0;
+	for(i = 0; i < v.num; i++){
+		for(j = 0; j < sp_playlist_num_tracks(v.shards[i]); j++){
+			sp_track *track = sp_playlist_track(v.shards[i], j);
+			if(track && track_to_URI(track, URI, sizeof(URI))){
+				fprintf(f, "%s\n", URI);
+				written++;
+			}
+		}
+	}
+	if(fclose(f))
+		perror(argv[2]);
+	printf("Wrote %d tracks to %s.\n", written, argv[2]);
+	vlist_free(&v);
+	return -1;
+}
+
+
+/**
+ * Rebalance the shards of a virtual playlist.
+ * 
+ * @param 1
+ * The name of the virtual playlist.
+ * 
+ * @return -1.
+ * */
+int cmd_vlist_rebalance(int argc, char **argv){
+	struct vlist v;
+	if(vlist_open(argv[1], &v))
+		return -1;
+	int changed = vlist_rebalance(&v);
+	if(changed >= 0)
+		printf("%d shards changed, %d left.\n", changed, v.num);
+	vlist_free(&v);
+	return -1;
+}
+
+
+/**
+ * Show or set the most tracks in a shard.
+ * 
+ * @param 1
+ * The new size, optional.
+ * 
+ * @return -1.
+ * */
+int cmd_vlist_size(int argc, char **argv){
+	if(argc == 2){
+		long n = cmd_arg_int(1, 0);
+		if(n < 1 || n > 1000000){
+			fprintf(stderr, "Bad shard size: %s\n", argv[1]);
+			return -1;
+		}
+		shard_size = n;
+	}
+	printf("Shards hold at most %d tracks.\n", shard_size);
+	return -1;
+}
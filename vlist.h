@@ -0,0 +1,11 @@
+#ifndef VLIST_H__
+#define VLIST_H__
+
+/* The most tracks in one shard of a virtual playlist, by default */
+#define VLIST_SHARD_SIZE 10000
+
+/* A shard, not the last, with less than this percent of the shard size
+ * has drifted, and gets filled up from the next one */
+#define VLIST_LOW_WATER 50
+
+#endif
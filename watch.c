@@ -0,0 +1,499 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "listify.h"
+#include "cmd.h"
+#include "link.h"
+#include "list.h"
+#include "ptrmap.h"
+#include "watch.h"
+
+
+/*
+ * The "watch" command turns the playlist and container callbacks into
+ * a stream of changes. Every change is one line, tab separated:
+ * 
+ *   <seq> add       <playlist-URI> <position> <track-URI> ...
+ *   <seq> remove    <playlist-URI> <index> ...
+ *   <seq> move      <playlist-URI> <new position> <index> ...
+ *   <seq> rename    <playlist-URI> <name>
+ *   <seq> pl_add    <playlist-URI> <container position> <name>
+ *   <seq> pl_remove <playlist-URI> <container position>
+ * 
+ * The sequence numbers have no gaps. A file is only ever appended to,
+ * and the numbers go on from the last line already in it, so a reader
+ * can stop and later go on from where it was.
+ * 
+ * A consumer of the Unix socket first sends the sequence number it
+ * wants to start at, on a line of its own, and then gets all changes
+ * from there on. The last WATCH_BACKLOG changes are kept for this. If
+ * it asks for something older, it gets a "gap <seq>" line, telling
+ * where the stream really starts.
+ * 
+ * While watching, every playlist is pinned so that its callbacks come.
+ * 
+ * */
+
+static FILE *watch_file;
+
+/// The playlists pinned by us, sp_playlist* --> itself
+static struct ptrmap pinned;
+
+/// Protects everything below, shared with the socket threads
+static pthread_mutex_t ring_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ring_cond = PTHREAD_COND_INITIALIZER;
+
+/// The last WATCH_BACKLOG changes, change seq is at seq % WATCH_BACKLOG
+static char *ring[WATCH_BACKLOG];
+static unsigned long long first_seq = 1;
+static unsigned long long next_seq = 1;
+
+static int listen_fd = -1;
+static int stopping;
+static int clients[WATCH_MAX_CLIENTS];
+static int num_clients;
+static pthread_t server_thread;
+
+
+/* -------------------------  MAKING THE LINES  ---------------------------- */
+
+struct line {
+	char *buf;
+	size_t len;
+	size_t cap;
+};
+
+
+static void line_add(struct line *l, const char *fmt, ...){
+	va_list ap;
+	while(1){
+		size_t room = l->cap - l->len;
+		va_start(ap, fmt);
+		int n = vsnprintf(l->buf ? l->buf + l->len : NULL, room, fmt, ap);
+		va_end(ap);
+		if(n < 0)
+			return;
+		if((size_t)n < room){
+			l->len += n;
+			return;
+		}
+		size_t cap = l->cap ? l->cap * 2 : 256;
+		while(cap < l->len + n + 1)
+			cap *= 2;
+		char *buf = realloc(l->buf, cap);
+		if(!buf)
+			return;
+		l->buf = buf;
+		l->cap = cap;
+	}
+}
+
+
+/**
+ * Names are free text, keep them from breaking the line up.
+ * */
+static void line_add_name(struct line *l, const char *name){
+	size_t start = l->len;
+	line_add(l, "%s", name ? name : "");
+	for(; l->buf && start < l->len; start++)
+		if(l->buf[start] == '\t' || l->buf[start] == '\n' || l->buf[start] == '\r')
+			l->buf[start] = ' ';
+}
+
+
+static void line_add_playlist(struct line *l, sp_playlist *pl){
+	char buff[256];
+	playlist_to_URI(pl, buff, sizeof(buff));
+	line_add(l, "\t%s", buff);
+}
+
+
+static void line_add_track(struct line *l, sp_track *track){
+	char buff[128];
+	track_to_URI(track, buff, sizeof(buff));
+	line_add(l, "\t%s", buff);
+}
+
+
+static int watching(void){
+	return watch_file || listen_fd >= 0;
+}
+
+
+/**
+ * Give the change its number and send it on. The number is only taken
+ * once the text has its memory, so every number in the ring is there.
+ * */
+static void publish(struct line *l){
+	if(!l->buf)
+		return;
+	line_add(l, "\n");
+
+	size_t len = strlen(l->buf);
+	char *text = malloc(len + 32);
+	if(!text){
+		fprintf(stderr, "Out of memory, a change wasn't watched.\n");
+		free(l->buf);
+		return;
+	}
+	pthread_mutex_lock(&ring_mutex);
+	unsigned long long seq = next_seq++;
+	snprintf(text, len + 32, "%llu\t%s", seq, l->buf);
+	char **slot = &ring[seq % WATCH_BACKLOG];
+	free(*slot);
+	*slot = text;
+	if(next_seq - first_seq > WATCH_BACKLOG)
+		first_seq = next_seq - WATCH_BACKLOG;
+	if(watch_file){
+		fputs(text, watch_file);
+		fflush(watch_file);
+	}
+	pthread_cond_broadcast(&ring_cond);
+	pthread_mutex_unlock(&ring_mutex);
+	free(l->buf);
+}
+
+
+/* ---------------------------  THE CALLBACKS  ----------------------------- */
+
+void watch_tracks_added(sp_playlist *pl, sp_track * const *tracks, int n, int position){
+	if(!watching())
+		return;
+	struct line l = { NULL, 0, 0 };
+	int i;
+	line_add(&l, "add");
+	line_add_playlist(&l, pl);
+	line_add(&l, "\t%d", position);
+	for(i = 0; i < n; i++)
+		line_add_track(&l, tracks[i]);
+	publish(&l);
+}
+
+
+void watch_tracks_removed(sp_playlist *pl, const int *tracks, int n){
+	if(!watching())
+		return;
+	struct line l = { NULL, 0, 0 };
+	int i;
+	line_add(&l, "remove");
+	line_add_playlist(&l, pl);
+	for(i = 0; i < n; i++)
+		line_add(&l, "\t%d", tracks[i]);
+	publish(&l);
+}
+
+
+void watch_tracks_moved(sp_playlist *pl, const int *tracks, int n, int new_position){
+	if(!watching())
+		return;
+	struct line l = { NULL, 0, 0 };
+	int i;
+	line_add(&l, "move");
+	line_add_playlist(&l, pl);
+	line_add(&l, "\t%d", new_position);
+	for(i = 0; i < n; i++)
+		line_add(&l, "\t%d", tracks[i]);
+	publish(&l);
+}
+
+
+void watch_playlist_renamed(sp_playlist *pl){
+	if(!watching())
+		return;
+	struct line l = { NULL, 0, 0 };
+	line_add(&l, "rename");
+	line_add_playlist(&l, pl);
+	line_add(&l, "\t");
+	line_add_name(&l, sp_playlist_name(pl));
+	publish(&l);
+}
+
+
+void watch_playlist_added(sp_playlist *pl, int position){
+	if(!watching())
+		return;
+	if(!ptrmap_get(&pinned, pl) && !ptrmap_put(&pinned, pl, pl))
+		playlist_pin(pl);
+	struct line l = { NULL, 0, 0 };
+	line_add(&l, "pl_add");
+	line_add_playlist(&l, pl);
+	line_add(&l, "\t%d\t", position);
+	line_add_name(&l, sp_playlist_name(pl));
+	publish(&l);
+}
+
+
+void watch_playlist_removed(sp_playlist *pl, int position){
+	if(ptrmap_remove(&pinned, pl))
+		playlist_unpin(pl);
+	if(!watching())
+		return;
+	struct line l = { NULL, 0, 0 };
+	line_add(&l, "pl_remove");
+	line_add_playlist(&l, pl);
+	line_add(&l, "\t%d", position);
+	publish(&l);
+}
+
+
+/* ---------------------------  THE SOCKET  -------------------------------- */
+
+static int send_all(int fd, const char *buf, size_t len){
+#ifdef MSG_NOSIGNAL
+	const int flags = MSG_NOSIGNAL;
+#else
+	const int flags = 0;
+#endif
+	while(len > 0){
+		ssize_t r = send(fd, buf, len, flags);
+		if(r < 0 && errno == EINTR)
+			continue;
+		if(r <= 0)
+			return -1;
+		buf += r;
+		len -= r;
+	}
+	return 0;
+}
+
+
+/**
+ * Serve one consumer: read where it wants to start, then send it
+ * every change from there on.
+ * */
+static void *serve_client(void *aux){
+	int fd = (int)(long)aux;
+	char req[64];
+	size_t got = 0;
+	ssize_t r;
+
+	while(got < sizeof(req) - 1 && (r = read(fd, req + got, 1)) == 1 && req[got] != '\n')
+		got++;
+	req[got] = '\0';
+	unsigned long long want = strtoull(req, NULL, 10);
+
+	pthread_mutex_lock(&ring_mutex);
+	while(!stopping){
+		char *text = NULL, gap[64];
+		if(want < first_seq){
+			snprintf(gap, sizeof(gap), "gap\t%llu\n", first_seq);
+			want = first_seq;
+			text = gap;
+		} else if(want < next_seq){
+			text = strdup(ring[want % WATCH_BACKLOG]);
+			want++;
+		} else {
+			pthread_cond_wait(&ring_cond, &ring_mutex);
+			continue;
+		}
+		pthread_mutex_unlock(&ring_mutex);
+		r = text ? send_all(fd, text, strlen(text)) : -1;
+		if(text != gap)
+			free(text);
+		pthread_mutex_lock(&ring_mutex);
+		if(r)
+			break;
+	}
+	int i;
+	for(i = 0; i < num_clients; i++){
+		if(clients[i] == fd){
+			clients[i] = clients[--num_clients];
+			break;
+		}
+	}
+	pthread_mutex_unlock(&ring_mutex);
+	close(fd);
+	return NULL;
+}
+
+
+static void *serve(void *aux){
+	while(1){
+		int fd = accept(listen_fd, NULL, NULL);
+		pthread_mutex_lock(&ring_mutex);
+		if(stopping){
+			pthread_mutex_unlock(&ring_mutex);
+			if(fd >= 0)
+				close(fd);
+			return NULL;
+		}
+		if(fd < 0 || num_clients == WATCH_MAX_CLIENTS){
+			pthread_mutex_unlock(&ring_mutex);
+			if(fd >= 0)
+				close(fd);
+			continue;
+		}
+		clients[num_clients++] = fd;
+		pthread_mutex_unlock(&ring_mutex);
+
+		pthread_t id;
+		if(pthread_create(&id, NULL, serve_client, (void*)(long)fd) == 0){
+			pthread_detach(id);
+		} else {
+			pthread_mutex_lock(&ring_mutex);
+			clients[--num_clients] = -1;
+			pthread_mutex_unlock(&ring_mutex);
+			close(fd);
+		}
+	}
+}
+
+
+static int socket_open(const char *path){
+	struct sockaddr_un addr;
+	if(strlen(path) >= sizeof(addr.sun_path)){
+		fprintf(stderr, "The socket path %s is too long\n", path);
+		return -1;
+	}
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd < 0){
+		perror("socket");
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	unlink(path);
+	if(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) || listen(fd, WATCH_MAX_CLIENTS)){
+		perror(path);
+		close(fd);
+		return -1;
+	}
+	stopping = 0;
+	listen_fd = fd;
+	if(pthread_create(&server_thread, NULL, serve, NULL)){
+		close(fd);
+		listen_fd = -1;
+		return -1;
+	}
+	return 0;
+}
+
+
+static void socket_close(void){
+	int i;
+	pthread_mutex_lock(&ring_mutex);
+	stopping = 1;
+	shutdown(listen_fd, SHUT_RDWR);
+	for(i = 0; i < num_clients; i++)
+		shutdown(clients[i], SHUT_RDWR);
+	pthread_cond_broadcast(&ring_cond);
+	pthread_mutex_unlock(&ring_mutex);
+	pthread_join(server_thread, NULL);
+	close(listen_fd);
+	listen_fd = -1;
+}
+
+
+/* ---------------------------  THE COMMANDS  ------------------------------ */
+
+/**
+ * Find the last sequence number written to a file.
+ * */
+static unsigned long long last_seq_in(FILE *f){
+	char buff[4096];
+	unsigned long long seq = 0;
+	long size;
+	if(fseek(f, 0, SEEK_END) || (size = ftell(f)) <= 0)
+		return 0;
+	long from = size > (long)sizeof(buff) - 1 ? size - (long)sizeof(buff) + 1 : 0;
+	fseek(f, from, SEEK_SET);
+	size_t n = fread(buff, 1, sizeof(buff) - 1, f);
+	buff[n] = '\0';
+	// The start of the last complete line
+	char *cp = buff + n;
+	if(cp > buff && cp[-1] == '\n')
+		cp--;
+	while(cp > buff && cp[-1] != '\n')
+		cp--;
+	sscanf(cp, "%llu", &seq);
+	return seq;
+}
+
+
+static void pin_container(void){
+	int i, n = sp_playlistcontainer_num_playlists(g_pc);
+	for(i = 0; i < n; i++){
+		sp_playlist *pl = sp_playlistcontainer_playlist(g_pc, i);
+		if(!ptrmap_get(&pinned, pl) && !ptrmap_put(&pinned, pl, pl))
+			playlist_pin(pl);
+	}
+}
+
+
+static void unpin_container(void){
+	unsigned int iter = 0;
+	void *key, *val;
+	while(ptrmap_next(&pinned, &iter, &key, &val))
+		playlist_unpin(key);
+	ptrmap_free(&pinned);
+}
+
+
+/**
+ * Start writing the changes to a file, or to a Unix socket.
+ * 
+ * @param 1
+ * The path of the file, or unix:<path> for a socket.
+ * 
+ * @return -1.
+ * */
+int cmd_watch(int argc, char **argv){
+	if(!strncmp(argv[1], "unix:", 5)){
+		if(listen_fd >= 0){
+			fprintf(stderr, "Already serving changes on a socket, unwatch first.\n");
+			return -1;
+		}
+		if(socket_open(argv[1] + 5))
+			return -1;
+	} else {
+		if(watch_file){
+			fprintf(stderr, "Already writing changes to a file, unwatch first.\n");
+			return -1;
+		}
+		FILE *f = fopen(argv[1], "a+");
+		if(!f){
+			fprintf(stderr, "Couldn't open the file %s\n", argv[1]);
+			return -1;
+		}
+		pthread_mutex_lock(&ring_mutex);
+		unsigned long long last = last_seq_in(f);
+		if(last >= next_seq)
+			first_seq = next_seq = last + 1;
+		watch_file = f;
+		pthread_mutex_unlock(&ring_mutex);
+	}
+	pin_container();
+	printf("Watching, the next change is number %llu.\n", next_seq);
+	return -1;
+}
+
+
+/**
+ * Stop writing changes.
+ * 
+ * @return -1.
+ * */
+int cmd_unwatch(int argc, char **argv){
+	if(!watching()){
+		fprintf(stderr, "Not watching.\n");
+		return -1;
+	}
+	if(listen_fd >= 0)
+		socket_close();
+	if(watch_file){
+		pthread_mutex_lock(&ring_mutex);
+		fclose(watch_file);
+		watch_file = NULL;
+		pthread_mutex_unlock(&ring_mutex);
+	}
+	unpin_container();
+	printf("Stopped watching after change number %llu.\n", next_seq - 1);
+	return -1;
+}
@@ -0,0 +1,19 @@
+#ifndef WATCH_H__
+#define WATCH_H__
+
+#include <libspotify/api.h>
+
+/* How many changes are kept for consumers of the socket to catch up on */
+#define WATCH_BACKLOG 4096
+
+/* The most consumers connected to the socket at once */
+#define WATCH_MAX_CLIENTS 16
+
+void watch_tracks_added(sp_playlist *pl, sp_track * const *tracks, int n, int position);
+void watch_tracks_removed(sp_playlist *pl, const int *tracks, int n);
+void watch_tracks_moved(sp_playlist *pl, const int *tracks, int n, int new_position);
+void watch_playlist_renamed(sp_playlist *pl);
+void watch_playlist_added(sp_playlist *pl, int position);
+void watch_playlist_removed(sp_playlist *pl, int position);
+
+#endif